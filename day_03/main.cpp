@@ -6,135 +6,315 @@
 #include <numeric>
 #include <array>
 #include <map>
+#include <bit>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "../common/utils.hpp"
 
-std::vector<std::string> parse_inputs(int argc, char* argv[]) {
+//
+// A diagnostic number wide enough to hold MaxWidth bits
+// > Stored as 64 bits words, being the first word the most significant one
+// > This way, the lexicographic comparison of std::array is also the numeric comparison
+//
+template <std::size_t MaxWidth>
+using DiagnosticNumber = std::array<uint64_t, (MaxWidth + 63) / 64>;
+
+template <std::size_t MaxWidth>
+struct DiagnosticReport {
+    std::size_t width = 0;
+    std::vector<DiagnosticNumber<MaxWidth>> numbers;
+};
+
+template <std::size_t MaxWidth>
+bool get_bit(const DiagnosticNumber<MaxWidth>& number, std::size_t bit) {
+    return (number[number.size() - 1 - bit / 64] >> (bit % 64)) & 1;
+}
+
+template <std::size_t MaxWidth>
+void set_bit(DiagnosticNumber<MaxWidth>& number, std::size_t bit) {
+    number[number.size() - 1 - bit / 64] |= 1ull << (bit % 64);
+}
+
+std::size_t parse_width(int argc, char* argv[]) {
+    // Makes sure a input file is specified
+    if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
+
+    // Open input file
+    std::ifstream input_file(std::string(argv[1]), std::ios::in);
+
+    // All the numbers have the same width as the first one
+    std::string line;
+    std::getline(input_file, line);
+
+    return line.size();
+}
+
+template <std::size_t MaxWidth>
+DiagnosticReport<MaxWidth> parse_inputs(int argc, char* argv[]) {
     // Makes sure a input file is specified
     if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
 
     // Actual output
-    std::vector<std::string> output;
+    DiagnosticReport<MaxWidth> output;
 
     // Open input file
     std::ifstream input_file(std::string(argv[1]), std::ios::in);
 
     // Read input data
+    // > Every number is packed into words right away (no more string handling afterwards)
     std::string line;
     while (std::getline(input_file, line)) {
-        output.push_back(line);
+        if (line.empty()) continue;
+
+        if (line.size() > MaxWidth) throw std::invalid_argument("Diagnostic number wider than " + std::to_string(MaxWidth) + " bits.");
+
+        DiagnosticNumber<MaxWidth> number = {};
+        for (std::size_t i = 0; i < line.size(); i++) {
+            if (line[line.size() - 1 - i] == '1') { set_bit<MaxWidth>(number, i); }
+        }
+
+        output.width = line.size();
+        output.numbers.push_back(number);
     }
 
     return output;
 }
 
+//
+// Transposes a 64x64 bit matrix in place
+// > After the transpose, the word at index 63-j holds the bit j of all the 64 input words
+// > Every step swaps blocks of j bits between the words i and i+j, in runs of j consecutive words
+// > The runs are processed 4 words at a time with AVX2 (or 2 with SSE2), and the shifts are the same for all the lanes
+//
+void transpose_64x64(std::array<uint64_t, 64>& block) {
+    uint64_t mask = 0x00000000FFFFFFFFull;
+    for (int j = 32; j != 0; j >>= 1, mask ^= (mask << j)) {
+        for (int base = 0; base < 64; base += 2 * j) {
+            int i = base;
+
+#if defined(__AVX2__)
+            const __m256i wide_mask = _mm256_set1_epi64x(mask);
+            const __m128i wide_shift = _mm_cvtsi32_si128(j);
+            for (; i + 4 <= base + j; i += 4) {
+                __m256i low = _mm256_loadu_si256((const __m256i*)(block.data() + i));
+                __m256i high = _mm256_loadu_si256((const __m256i*)(block.data() + i + j));
+                const __m256i swap = _mm256_and_si256(_mm256_xor_si256(low, _mm256_srl_epi64(high, wide_shift)), wide_mask);
+                low = _mm256_xor_si256(low, swap);
+                high = _mm256_xor_si256(high, _mm256_sll_epi64(swap, wide_shift));
+                _mm256_storeu_si256((__m256i*)(block.data() + i), low);
+                _mm256_storeu_si256((__m256i*)(block.data() + i + j), high);
+            }
+#endif
+
+#if defined(__SSE2__)
+            const __m128i narrow_mask = _mm_set1_epi64x(mask);
+            const __m128i narrow_shift = _mm_cvtsi32_si128(j);
+            for (; i + 2 <= base + j; i += 2) {
+                __m128i low = _mm_loadu_si128((const __m128i*)(block.data() + i));
+                __m128i high = _mm_loadu_si128((const __m128i*)(block.data() + i + j));
+                const __m128i swap = _mm_and_si128(_mm_xor_si128(low, _mm_srl_epi64(high, narrow_shift)), narrow_mask);
+                low = _mm_xor_si128(low, swap);
+                high = _mm_xor_si128(high, _mm_sll_epi64(swap, narrow_shift));
+                _mm_storeu_si128((__m128i*)(block.data() + i), low);
+                _mm_storeu_si128((__m128i*)(block.data() + i + j), high);
+            }
+#endif
+
+            // Remaining words (the whole run without SIMD, or the single word runs of the last step)
+            for (; i < base + j; i++) {
+                uint64_t swap = (block[i] ^ (block[i + j] >> j)) & mask;
+                block[i] ^= swap;
+                block[i + j] ^= swap << j;
+            }
+        }
+    }
+}
+
+//
+// Counts, for every bit position, how many numbers have that bit set
+// > Numbers are processed in blocks of 64, which are transposed so each column becomes a single word
+// > The column counts are then just the popcount of each transposed word
+// > Wider numbers run the very same kernel once per word, so the cost per bit does not depend on the width
+//
+template <std::size_t MaxWidth>
+std::vector<uint64_t> count_column_ones(const std::vector<DiagnosticNumber<MaxWidth>>& numbers) {
+    constexpr std::size_t WORDS = (MaxWidth + 63) / 64;
 
+    std::vector<uint64_t> ones(WORDS * 64, 0);
+    std::array<uint64_t, 64> block;
 
-int main(int argc, char* argv[]) {
-    // Common
-    std::vector<std::string> numbers = parse_inputs(argc, argv);
+    for (std::size_t start = 0; start < numbers.size(); start += 64) {
+        std::size_t block_size = std::min<std::size_t>(64, numbers.size() - start);
 
-    // Part One algorithms
-    uint64_t gamma = 0;
-    uint64_t epsilon = 0;
+        for (std::size_t word = 0; word < WORDS; word++) {
+            // Loads the block (the tail block is padded with zeros, which do not affect the counts)
+            for (std::size_t i = 0; i < block_size; i++) { block[i] = numbers[start + i][word]; }
+            std::fill(block.begin() + block_size, block.end(), 0);
 
-    float part_1_elapsed_time = time_block( [&](){
-        // Mask has the purpose of removing unwanted flipped bits
-        // > Calculating epsilon will flip all 64 bits, but not all bits may be relevant.
-        // > If each number has a length of x bits, where x < 64, all the remaining bits from x to 64 are not valid. This will replace them with 0's.
-        uint64_t mask = 0;
-
-        for (int i = 0; i < numbers[0].size(); i++) {
-            // Finds the amount of 0's and 1's
-            uint64_t zeros = 0, ones = 0;
-            for (auto number : numbers) {
-                number[i] == '0' ? zeros++ : ones++;
+            transpose_64x64(block);
+
+            // Bits of this word start at this bit position
+            std::size_t offset = 64 * (WORDS - 1 - word);
+            for (int bit = 0; bit < 64; bit++) {
+                ones[offset + bit] += std::popcount(block[63 - bit]);
             }
+        }
+    }
+
+    return ones;
+}
+
+//
+// Searches a rating in a sorted list of numbers
+// > Since the list is sorted, all numbers sharing the already selected prefix form a contiguous range
+// > Inside that range, the numbers with the current bit at 0 come before the ones with it at 1
+// > Each step is then a binary search for the split point, which shrinks the range in place
+//
+template <std::size_t MaxWidth>
+DiagnosticNumber<MaxWidth> find_rating(const std::vector<DiagnosticNumber<MaxWidth>>& sorted_numbers, std::size_t width, bool most_common) {
+    auto begin = sorted_numbers.begin();
+    auto end = sorted_numbers.end();
+
+    for (int i = width - 1; i >= 0 && end - begin > 1; i--) {
+        // Finds where the numbers with the current bit at 1 start
+        auto split = std::partition_point(begin, end, [i](const DiagnosticNumber<MaxWidth>& number){ return !get_bit<MaxWidth>(number, i); });
+
+        // Finds the amount of 0's and 1's
+        auto zeros = split - begin;
+        auto ones = end - split;
+
+        // Keeps the selected half (if the selected half is empty, the other one is kept)
+        bool keep_ones = most_common ? (ones >= zeros) : (ones < zeros);
+        if (keep_ones ? ones == 0 : zeros == 0) { keep_ones = !keep_ones; }
 
-            // Updates the gamma
-            gamma = (gamma << 1) | (ones >= zeros);
+        if (keep_ones) { begin = split; } else { end = split; }
+    }
+
+    return *begin;
+}
 
-            // Updates the mask relevant bits
-            mask = (mask << 1) | 1;
+//
+// Multiplies two numbers (the result has twice the words, so it never overflows)
+//
+template <std::size_t Words>
+std::array<uint64_t, 2 * Words> multiply(const std::array<uint64_t, Words>& a, const std::array<uint64_t, Words>& b) {
+    std::array<uint64_t, 2 * Words> result = {};
+
+    // Schoolbook multiplication, going from the least to the most significant words
+    for (std::size_t i = 0; i < Words; i++) {
+        unsigned __int128 carry = 0;
+        for (std::size_t j = 0; j < Words; j++) {
+            std::size_t k = 2 * Words - 1 - (i + j);
+            unsigned __int128 value = (unsigned __int128)a[Words - 1 - i] * b[Words - 1 - j] + result[k] + carry;
+            result[k] = (uint64_t)value;
+            carry = value >> 64;
         }
+        result[Words - 1 - i] = (uint64_t)carry;
+    }
+
+    return result;
+}
+
+//
+// Converts a number of any amount of words into its decimal representation
+//
+template <std::size_t Words>
+std::string to_decimal(std::array<uint64_t, Words> number) {
+    constexpr uint64_t BASE = 10000000000000000000ull; // 10^19
+
+    std::vector<uint64_t> chunks;
+    while (std::any_of(number.begin(), number.end(), [](const uint64_t& word){ return word != 0; })) {
+        // Long division by the base, from the most significant word
+        unsigned __int128 remainder = 0;
+        for (auto & word : number) {
+            unsigned __int128 value = (remainder << 64) | word;
+            word = (uint64_t)(value / BASE);
+            remainder = value % BASE;
+        }
+        chunks.push_back((uint64_t)remainder);
+    }
+
+    if (chunks.empty()) return "0";
+
+    // Most significant chunk has no padding, all others have 19 digits
+    std::string output = std::to_string(chunks.back());
+    for (auto chunk = chunks.rbegin() + 1; chunk != chunks.rend(); chunk++) {
+        std::string digits = std::to_string(*chunk);
+        output += std::string(19 - digits.size(), '0') + digits;
+    }
+
+    return output;
+}
+
+
+
+template <std::size_t MaxWidth>
+int solve(int argc, char* argv[]) {
+    // Common
+    const auto [width, numbers] = parse_inputs<MaxWidth>(argc, argv);
+
+    // Part One algorithms
+    DiagnosticNumber<MaxWidth> gamma = {};
+    DiagnosticNumber<MaxWidth> epsilon = {};
+
+    float part_1_elapsed_time = time_block( [&](){
+        // Finds the amount of 1's in every bit position at once
+        std::vector<uint64_t> ones = count_column_ones<MaxWidth>(numbers);
 
-        // Calculates the epsilon
-        epsilon = (~gamma & mask);
+        // Updates the gamma (most common bit of each position) and the epsilon (least common bit of each position)
+        // > Only the first width bits are relevant, all the remaining ones stay at 0
+        for (std::size_t i = 0; i < width; i++) {
+            uint64_t zeros = numbers.size() - ones[i];
+            if (ones[i] >= zeros) { set_bit<MaxWidth>(gamma, i); } else { set_bit<MaxWidth>(epsilon, i); }
+        }
     });
-    
+
     // Part One visualization
     printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
-    printf("   1. The report shows that gamma and epsilon values are %lu and %lu, respectively.\n", gamma, epsilon);
-    printf("   2. This concludes that the power consumption of the submarine is %lu.\n", epsilon * gamma);
-    
+    printf("   1. The report shows that gamma and epsilon values are %s and %s, respectively.\n", to_decimal(gamma).c_str(), to_decimal(epsilon).c_str());
+    printf("   2. This concludes that the power consumption of the submarine is %s.\n", to_decimal(multiply(epsilon, gamma)).c_str());
+
 
 
     // Part Two algorithms
-    uint64_t oxygen_generator = 0;
-    uint64_t co2_scrubber = 0;
+    DiagnosticNumber<MaxWidth> oxygen_generator = {};
+    DiagnosticNumber<MaxWidth> co2_scrubber = {};
 
     float part_2_elapsed_time = time_block( [&](){
-        // Oxygen generator rating search
-        std::vector<std::string> oxygen_numbers_list = numbers;
-        for (int i = 0; i < numbers[0].size(); i++) {
-            // Finds the amount of 0's and 1's
-            uint64_t zeros = 0, ones = 0;
-            std::vector<std::string> zero_numbers = {}, one_numbers = {};
-            for (auto number : oxygen_numbers_list) {
-                if (number[i] == '0') {
-                    zeros++;
-                    zero_numbers.push_back(number);
-                } else {
-                    ones++;
-                    one_numbers.push_back(number);
-                }
-            }
-
-            // Updates the oxygen numbers list for the next search
-            oxygen_numbers_list = (ones >= zeros) ? one_numbers : zero_numbers;
+        // Both searches share the same sorted list of numbers
+        std::vector<DiagnosticNumber<MaxWidth>> sorted_numbers = numbers;
+        std::sort(sorted_numbers.begin(), sorted_numbers.end());
 
-            // Exit check
-            if (oxygen_numbers_list.size() <= 1) {
-                for (auto number : oxygen_numbers_list[0]) {
-                    oxygen_generator = (oxygen_generator << 1) | (number == '0' ? 0 : 1);
-                }
-                break;
-            }
-        }
+        // Oxygen generator rating search
+        oxygen_generator = find_rating<MaxWidth>(sorted_numbers, width, true);
 
         // CO2 Scrubber rating search
-        std::vector<std::string> co2_numbers_list = numbers;
-        for (int i = 0; i < numbers[0].size(); i++) {
-            // Finds the amount of 0's and 1's
-            uint64_t zeros = 0, ones = 0;
-            std::vector<std::string> zero_numbers = {}, one_numbers = {};
-            for (auto number : co2_numbers_list) {
-                if (number[i] == '0') {
-                    zeros++;
-                    zero_numbers.push_back(number);
-                } else {
-                    ones++;
-                    one_numbers.push_back(number);
-                }
-            }
-
-            // Updates the co2 numbers list for the next search
-            co2_numbers_list = (ones < zeros) ? one_numbers : zero_numbers;
-
-            // Exit check
-            if (co2_numbers_list.size() <= 1) {
-                for (auto number : co2_numbers_list[0]) {
-                    co2_scrubber = (co2_scrubber << 1) | (number == '0' ? 0 : 1);
-                }
-                break;
-            }
-        }
+        co2_scrubber = find_rating<MaxWidth>(sorted_numbers, width, false);
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
-    printf("   1. The report shows that oxygen generator and co2 scrubber ratings are %lu and %lu, respectively.\n", oxygen_generator, co2_scrubber);
-    printf("   2. This concludes that the life support rating of the submarine is %lu.\n", oxygen_generator * co2_scrubber);
+    printf("   1. The report shows that oxygen generator and co2 scrubber ratings are %s and %s, respectively.\n", to_decimal(oxygen_generator).c_str(), to_decimal(co2_scrubber).c_str());
+    printf("   2. This concludes that the life support rating of the submarine is %s.\n", to_decimal(multiply(oxygen_generator, co2_scrubber)).c_str());
 
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    // The width of the numbers is only known at runtime
+    // > Dispatches to the narrowest engine that is able to hold them
+    std::size_t width = parse_width(argc, argv);
+
+    if (width <= 64) return solve<64>(argc, argv);
+    if (width <= 128) return solve<128>(argc, argv);
+    if (width <= 256) return solve<256>(argc, argv);
+    if (width <= 512) return solve<512>(argc, argv);
+
+    throw std::invalid_argument("Diagnostic numbers wider than 512 bits are not supported.");
+}
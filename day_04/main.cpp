@@ -7,86 +7,176 @@
 #include <array>
 #include <tuple>
 #include <cmath>
-#include <unordered_map>
+#include <cstdint>
+#include <span>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <sstream>
+#include <iterator>
+#include <type_traits>
 
 #include "../common/utils.hpp"
 
-#define BOARD_SIZE 5
+// Biggest board whose cells still fit in a 128 bits mask
+#define MAX_BOARD_SIZE 11
 
+//
+// Marked cells mask of a board, being the narrowest word that holds all of its cells
+//
+template <int Size>
+using BoardMask = std::conditional_t<(Size * Size <= 32), uint32_t,
+                  std::conditional_t<(Size * Size <= 64), uint64_t, unsigned __int128>>;
 
 
+
+template <int Size>
 class Board
 {
-private:
-    struct Position { int x = 0, y = 0; };
+    static_assert(Size > 0 && Size <= MAX_BOARD_SIZE, "Board cells do not fit in a 128 bits mask.");
+
+public:
+    using Mask = BoardMask<Size>;
 
 private:
-    std::unordered_map<int, Position> _num2pos_map;
-    std::unordered_map<std::string, std::array<std::vector<int>, BOARD_SIZE>> _register;
+    // Cells are indexed row by row (cell = y * Size + x), each one being a bit of the marked mask
+    std::array<int, Size * Size> _cells;
+    Mask _marked;
 
     bool _has_bingo;
 
 private:
-    bool _check_if_has_bingo(const Position &pos) {
-        if (_register["row"][pos.y].size() == BOARD_SIZE) { _has_bingo = true; }
-        if (_register["col"][pos.x].size() == BOARD_SIZE) { _has_bingo = true; }
-        return _has_bingo;
+    // Win masks of every row and column, built once at compile time
+    static constexpr std::array<Mask, Size> _make_row_masks() {
+        std::array<Mask, Size> masks = {};
+        for (int y = 0; y < Size; y++) { masks[y] = ((Mask(1) << Size) - 1) << (y * Size); }
+        return masks;
     }
 
-public:
-    Board() = delete;
-    Board(std::vector<std::string> board_data) : _has_bingo(false), _register({ {"row",{}}, {"col",{}} }) {
-        // Unwraps the raw board data
-        for (int i = 0; i < BOARD_SIZE; i++) {
-            const std::string &line = board_data[i];
-            for (int j = 0; j < BOARD_SIZE; j++) { 
-                // Crops the number from the line
-                std::string number(&line[3*j], &line[3*j+2]);
-
-                // Inserts the number into the map
-                _num2pos_map[std::stoi(number)] = {j,i};
-            }
+    static constexpr std::array<Mask, Size> _make_col_masks() {
+        std::array<Mask, Size> masks = {};
+        for (int x = 0; x < Size; x++) {
+            for (int y = 0; y < Size; y++) { masks[x] |= Mask(1) << (y * Size + x); }
         }
+        return masks;
     }
 
-    bool register_number(const int& number) {
-        if (_num2pos_map.find(number) == _num2pos_map.end()) { return false; }
+    static constexpr std::array<Mask, Size> ROW_MASKS = _make_row_masks();
+    static constexpr std::array<Mask, Size> COL_MASKS = _make_col_masks();
 
-        Position pos = _num2pos_map[number];
+    bool _check_if_has_bingo(const int &cell) {
+        // Only the row and column of the marked cell can have been completed
+        const Mask& row = ROW_MASKS[cell / Size];
+        const Mask& col = COL_MASKS[cell % Size];
 
-        // Registers the number in the register
-        _register["row"][pos.y].push_back(number);
-        _register["col"][pos.x].push_back(number);
+        if ((_marked & row) == row) { _has_bingo = true; }
+        if ((_marked & col) == col) { _has_bingo = true; }
+        return _has_bingo;
+    }
 
-        // Removes the number from the map
-        _num2pos_map.erase(number);
+public:
+    Board() = delete;
+    Board(const std::array<int, Size * Size>& cells) : _cells(cells), _marked(0), _has_bingo(false) {}
+
+    bool mark_cell(const int& cell) {
+        _marked |= Mask(1) << cell;
 
         // Checks if the board has Bingo!
-        return _check_if_has_bingo(pos);
+        return _check_if_has_bingo(cell);
     }
 
-    bool has_bingo() { return _has_bingo; }
+    bool has_bingo() const { return _has_bingo; }
+
+    const std::array<int, Size * Size>& get_cells() const { return _cells; }
 
-    std::vector<int> get_remaining_values() {
-        std::vector<int> output;
+    int get_remaining_sum() const {
+        int output = 0;
 
-        for (const auto & [value, pos] : _num2pos_map ) {
-            output.push_back(value);
+        for (int cell = 0; cell < Size * Size; cell++) {
+            if (!(_marked & (Mask(1) << cell))) { output += _cells[cell]; }
         }
 
         return output;
     }
 };
 
+//
+// Inverted index from every number to the boards (and cells) where it appears
+// > The hits of all numbers are stored contiguously, number after number (offsets tell where each one starts)
+// > This way, drawing a number only touches the boards that actually have it
+//
+template <int Size>
+class BingoIndex
+{
+public:
+    struct Hit { int board = 0, cell = 0; };
+
+private:
+    std::vector<std::size_t> _offsets;
+    std::vector<Hit> _hits;
+
+public:
+    BingoIndex() = delete;
+    BingoIndex(const std::vector<Board<Size>>& boards) {
+        // Finds the biggest number in the boards
+        int max_number = 0;
+        for (const auto & board : boards) {
+            for (const auto & value : board.get_cells()) { max_number = std::max(max_number, value); }
+        }
+
+        // Counts the hits of each number
+        _offsets.assign(max_number + 2, 0);
+        for (const auto & board : boards) {
+            for (const auto & value : board.get_cells()) { ++_offsets[value + 1]; }
+        }
+        std::partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+
+        // Places the hits in their number slots
+        std::vector<std::size_t> next(_offsets.begin(), _offsets.end() - 1);
+        _hits.resize(_offsets.back());
+        for (int b = 0; b < boards.size(); b++) {
+            const auto & cells = boards[b].get_cells();
+            for (int cell = 0; cell < cells.size(); cell++) { _hits[next[cells[cell]]++] = {b, cell}; }
+        }
+    }
+
+    std::span<const Hit> get_hits(const int& number) const {
+        if (number < 0 || number + 1 >= _offsets.size()) { return {}; }
+        return { _hits.data() + _offsets[number], _hits.data() + _offsets[number + 1] };
+    }
+};
+
 
 
-std::tuple<std::vector<int>, std::vector<Board>> parse_inputs(int argc, char* argv[]) {
+int parse_board_size(int argc, char* argv[]) {
+    // Makes sure a input file is specified
+    if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
+
+    // Open input file
+    std::ifstream input_file(std::string(argv[1]), std::ios::in);
+
+    // First line is always the random numbers
+    std::string line;
+    std::getline(input_file, line);
+
+    // The amount of values in the first row of the first board is the board size
+    while (std::getline(input_file, line)) {
+        std::istringstream row(line);
+        int size = std::distance(std::istream_iterator<int>(row), std::istream_iterator<int>());
+        if (size) return size;
+    }
+
+    return 0;
+}
+
+template <int Size>
+std::tuple<std::vector<int>, std::vector<Board<Size>>> parse_inputs(int argc, char* argv[]) {
     // Makes sure a input file is specified
     if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
 
     // Actual outputs
     std::vector<int> numbers;
-    std::vector<Board> boards;
+    std::vector<Board<Size>> boards;
 
     // Open input file
     std::ifstream input_file(std::string(argv[1]), std::ios::in);
@@ -99,60 +189,200 @@ std::tuple<std::vector<int>, std::vector<Board>> parse_inputs(int argc, char* ar
     std::vector<std::string> str_numbers = string_split(line, ",");
     std::transform(str_numbers.begin(), str_numbers.end(), std::back_inserter(numbers), [](const std::string &value){return std::stoi(value);});
 
-    // The other lines have the boards
-    while (true) {
-        // First line is to be ignore - is empty
-        if (!std::getline(input_file, line)) break;
+    // The rest of the file has the boards
+    // > Values are read one by one regardless of the spacing between them (and of the empty lines between boards)
+    std::array<int, Size * Size> cells;
+    int cell = 0;
+    int value;
+    while (input_file >> value) {
+        cells[cell++] = value;
+        if (cell == Size * Size) { boards.push_back(cells); cell = 0; }
+    }
 
-        std::vector<std::string> board_data;
+    if (cell != 0) throw std::invalid_argument("The last board is incomplete.");
 
-        for (int i = 0 ; i < BOARD_SIZE ; i++) {
-            std::getline(input_file, line);
-            board_data.push_back(line);
-        }
+    return {numbers, boards};
+}
+
+
+
+//
+// Plays the game number by number, returning the score of the first (or the last) board to win
+//
+template <int Size>
+int replay_game(const std::vector<int>& numbers, std::vector<Board<Size>> boards, const BingoIndex<Size>& index, bool last_winner) {
+    // Control variable to know how many boards are already completed
+    int completed_boards = 0;
+
+    // Withdraws the numbers
+    for (const auto & number : numbers) {
+        for (const auto & [b, cell] : index.get_hits(number)) {
+            // Ignores the board if it already has bingo
+            if ( boards[b].has_bingo() ) { continue; }
 
-        boards.push_back(board_data);
+            // Checks if the board has bingo!
+            if (!boards[b].mark_cell(cell)) { continue; }
+
+            // Updates the amount of boards that were already completed
+            completed_boards++;
+
+            // The score is the sum of all the remaining values multiplied by the last withdrawn number
+            if (!last_winner || completed_boards == boards.size()) {
+                return boards[b].get_remaining_sum() * number;
+            }
+        }
     }
 
-    return {numbers, boards};
+    return 0;
 }
 
+//
+// Finds when every board wins without playing the game
+// > A cell is marked at the turn its number is drawn, so a line is completed at the latest turn among its cells
+// > A board wins at the earliest turn among its lines
+// > Both the first and the last winner come out of the same pass
+//
+template <int Size>
+class WinTimeSolver
+{
+public:
+    static constexpr int NEVER = std::numeric_limits<int>::max();
 
+private:
+    // Boards are processed in groups, laid out cell by cell (turns of the same cell of all boards are contiguous)
+    // > This way, every step is an element-wise operation across the whole group, which gets vectorized
+    static constexpr int GROUP_SIZE = 64;
 
-int main(int argc, char* argv[]) {
-    // Common
-    const auto [NUMBERS, BOARDS] = parse_inputs(argc, argv);
+    // Minimum amount of boards that justify an extra thread
+    static constexpr int BOARDS_PER_THREAD = 4096;
 
-    // Part One algorithms
-    int result_1 = 1;
+    std::vector<int> _draw_turns;
+    std::vector<int> _win_turns;
 
-    float part_1_elapsed_time = time_block( [&](){
-        // Makes a copy of the boards
-        std::vector<Board> boards = BOARDS;
-
-        // Control variable to check if someone made bingo!
-        bool bingo = false;
-
-        // Withdraws the numbers
-        for (const auto & number : NUMBERS) {
-            for (auto & board : boards) {
-                // Registers the withdrawn number into the board
-                bingo = board.register_number(number);
-
-                // Checks if the board has bingo!
-                if (bingo) {
-                    // Gets the values from the board that were not withdrawn
-                    std::vector<int> remaining_values = board.get_remaining_values();
-                    
-                    // Updates the final result value with the sum of all the remaining values
-                    result_1 *= std::accumulate(remaining_values.begin(), remaining_values.end(), 0);
-
-                    break;
+private:
+    int _get_draw_turn(const int& number) const {
+        return (number >= 0 && number < _draw_turns.size()) ? _draw_turns[number] : NEVER;
+    }
+
+    void _solve_range(const std::vector<Board<Size>>& boards, std::size_t begin, std::size_t end) {
+        constexpr int CELLS = Size * Size;
+
+        std::array<std::array<int, GROUP_SIZE>, CELLS> turns;
+        std::array<int, GROUP_SIZE> line_turns;
+        std::array<int, GROUP_SIZE> win_turns;
+
+        for (std::size_t start = begin; start < end; start += GROUP_SIZE) {
+            std::size_t group_size = std::min<std::size_t>(GROUP_SIZE, end - start);
+
+            // Loads the turn of every cell (the tail of the last group is never drawn)
+            for (int cell = 0; cell < CELLS; cell++) {
+                for (int g = 0; g < group_size; g++) { turns[cell][g] = _get_draw_turn(boards[start + g].get_cells()[cell]); }
+                for (int g = group_size; g < GROUP_SIZE; g++) { turns[cell][g] = NEVER; }
+            }
+
+            win_turns.fill(NEVER);
+
+            for (int line = 0; line < Size; line++) {
+                // Row
+                line_turns.fill(0);
+                for (int i = 0; i < Size; i++) {
+                    const auto & cell_turns = turns[line * Size + i];
+                    for (int g = 0; g < GROUP_SIZE; g++) { line_turns[g] = std::max(line_turns[g], cell_turns[g]); }
                 }
+                for (int g = 0; g < GROUP_SIZE; g++) { win_turns[g] = std::min(win_turns[g], line_turns[g]); }
+
+                // Column
+                line_turns.fill(0);
+                for (int i = 0; i < Size; i++) {
+                    const auto & cell_turns = turns[i * Size + line];
+                    for (int g = 0; g < GROUP_SIZE; g++) { line_turns[g] = std::max(line_turns[g], cell_turns[g]); }
+                }
+                for (int g = 0; g < GROUP_SIZE; g++) { win_turns[g] = std::min(win_turns[g], line_turns[g]); }
             }
 
-            // Updates the final result value by multiplying it with the last withdrawn number
-            if (bingo) { result_1 *= number; break; }
+            std::copy_n(win_turns.begin(), group_size, _win_turns.begin() + start);
+        }
+    }
+
+public:
+    WinTimeSolver() = delete;
+    WinTimeSolver(const std::vector<int>& numbers, const std::vector<Board<Size>>& boards) {
+        // Maps every number to the turn it is drawn (only the first draw counts)
+        int max_number = numbers.empty() ? 0 : *std::max_element(numbers.begin(), numbers.end());
+        _draw_turns.assign(max_number + 1, NEVER);
+        for (int turn = numbers.size() - 1; turn >= 0; turn--) {
+            if (numbers[turn] >= 0) { _draw_turns[numbers[turn]] = turn; }
+        }
+
+        // Splits the boards among the threads (in whole groups)
+        _win_turns.resize(boards.size());
+
+        std::size_t n_threads = std::clamp<std::size_t>(boards.size() / BOARDS_PER_THREAD, 1, std::max(1u, std::thread::hardware_concurrency()));
+        std::size_t chunk = (boards.size() / n_threads + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+
+        std::vector<std::thread> workers;
+        for (std::size_t begin = 0; begin < boards.size(); begin += chunk) {
+            std::size_t end = std::min(boards.size(), begin + chunk);
+            workers.emplace_back([this, &boards, begin, end](){ _solve_range(boards, begin, end); });
+        }
+        for (auto & worker : workers) { worker.join(); }
+    }
+
+    const std::vector<int>& get_win_turns() const { return _win_turns; }
+
+    // First board to win (if several win at the same turn, the first one in the list is the one to claim it)
+    int find_first_winner() const {
+        auto winner = std::min_element(_win_turns.begin(), _win_turns.end());
+        return (winner == _win_turns.end() || *winner == NEVER) ? -1 : winner - _win_turns.begin();
+    }
+
+    // Last board to win (if several win at the same turn, the last one in the list is the one to complete it)
+    // > There is no last winner while some board never wins, same as when replaying the game
+    int find_last_winner() const {
+        int winner = -1;
+        for (int b = 0; b < _win_turns.size(); b++) {
+            if (_win_turns[b] == NEVER) { return -1; }
+            if (winner < 0 || _win_turns[b] >= _win_turns[winner]) { winner = b; }
+        }
+        return winner;
+    }
+
+    int get_score(const int& board_index, const std::vector<Board<Size>>& boards, const std::vector<int>& numbers) const {
+        if (board_index < 0) { return 0; }
+
+        const int win_turn = _win_turns[board_index];
+
+        // Sums all the values that were not withdrawn when the board won
+        int remaining_sum = 0;
+        for (const auto & value : boards[board_index].get_cells()) {
+            if (_get_draw_turn(value) > win_turn) { remaining_sum += value; }
+        }
+
+        return remaining_sum * numbers[win_turn];
+    }
+};
+
+
+
+template <int Size>
+int solve(int argc, char* argv[]) {
+    // Common
+    const auto [NUMBERS, BOARDS] = parse_inputs<Size>(argc, argv);
+
+    // The win time solver is used by default
+    // > The game can be played number by number instead with the "--replay" option
+    const bool REPLAY = argc > 2 && std::string(argv[2]) == "--replay";
+
+    // Part One algorithms
+    int result_1 = 0;
+    std::optional<WinTimeSolver<Size>> solver;
+
+    float part_1_elapsed_time = time_block( [&](){
+        if (REPLAY) {
+            result_1 = replay_game(NUMBERS, BOARDS, BingoIndex<Size>(BOARDS), false);
+        } else {
+            solver.emplace(NUMBERS, BOARDS);
+            result_1 = solver->get_score(solver->find_first_winner(), BOARDS, NUMBERS);
         }
     });
     
@@ -163,39 +393,14 @@ int main(int argc, char* argv[]) {
 
 
     // Part Two algorithms
-    int result_2 = 1;
+    int result_2 = 0;
 
     float part_2_elapsed_time = time_block( [&](){
-        // Makes a copy of the boards
-        std::vector<Board> boards = BOARDS;
-
-        // Control variable to know how many boards are already completed
-        int completed_boards = 0;
-
-        // Withdraws the numbers
-        for (const auto & number : NUMBERS) {
-            for (auto & board : boards) {
-                // Ignores the board if it already has bingo
-                if ( board.has_bingo() ) { continue; }
-
-                // Checks if the board has bingo!
-                if (board.register_number(number)) {
-                    // Updates the amount of boards that were already completed
-                    completed_boards++;
-
-                    // Only cares to calculate the result if this was the last board to win
-                    if (completed_boards == boards.size()) {
-                        // Gets the values from the board that were not withdrawn
-                        std::vector<int> remaining_values = board.get_remaining_values();
-                        
-                        // Updates the final result value with the sum of all the remaining values
-                        result_2 *= std::accumulate(remaining_values.begin(), remaining_values.end(), 0);
-                    }
-                }
-            }
-
-            // Updates the final result value by multiplying it with the last withdrawn number
-            if (completed_boards == boards.size()) { result_2 *= number; break; }
+        if (REPLAY) {
+            result_2 = replay_game(NUMBERS, BOARDS, BingoIndex<Size>(BOARDS), true);
+        } else {
+            // The win turns of all the boards were already found in Part One
+            result_2 = solver->get_score(solver->find_last_winner(), BOARDS, NUMBERS);
         }
     });
 
@@ -205,3 +410,19 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+//
+// Runs the engine built for the board size found in the input
+//
+template <int Size = 1>
+int dispatch(int size, int argc, char* argv[]) {
+    if constexpr (Size > MAX_BOARD_SIZE) {
+        throw std::invalid_argument("Boards bigger than " + std::to_string(MAX_BOARD_SIZE) + "x" + std::to_string(MAX_BOARD_SIZE) + " are not supported.");
+    } else {
+        return (size == Size) ? solve<Size>(argc, argv) : dispatch<Size + 1>(size, argc, argv);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    return dispatch(parse_board_size(argc, argv), argc, argv);
+}
@@ -3,27 +3,71 @@
 #include <vector>
 #include <stdexcept>
 #include <cmath>
-#include <map>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <utility>
+#include <thread>
+#include <numeric>
 
 #include "../common/utils.hpp"
 
 
 struct Point {
     int x = 0, y = 0;
+};
 
-    // Operator that allows the structure to be inserted in a map/set as key
-    bool operator<(Point const &p) const {
-        return x < p.x || (x == p.x && y < p.y);
-    }
+struct Box {
+    Point min = {}, max = {};
+
+    int64_t width() const { return (int64_t)max.x - min.x + 1; }
+    int64_t height() const { return (int64_t)max.y - min.y + 1; }
 };
 
 class LineSegment
 {
+public:
+    //
+    // Lazy range over the points of the line (points are generated while iterating, never stored)
+    //
+    class Points
+    {
+    public:
+        class iterator
+        {
+        private:
+            Point _point, _step;
+            int64_t _index;
+
+        public:
+            iterator(const Point& point, const Point& step, int64_t index) : _point(point), _step(step), _index(index) {}
+
+            const Point& operator*() const { return _point; }
+            iterator& operator++() { _point.x += _step.x; _point.y += _step.y; ++_index; return *this; }
+            bool operator!=(const iterator& other) const { return _index != other._index; }
+        };
+
+    private:
+        Point _start, _step;
+        int64_t _length;
+
+    public:
+        Points(const Point& start, const Point& step, int64_t length) : _start(start), _step(step), _length(length) {}
+
+        iterator begin() const { return { _start, _step, 0 }; }
+        iterator end() const { return { _start, _step, _length }; }
+    };
+
 private:
-    std::vector<Point> _points;
+    Point _start;
+    Point _step;
+    int64_t _length;
 
 public:
     LineSegment() = delete;
+    LineSegment(const Point& start, const Point& step, const int64_t& length) : _start(start), _step(step), _length(length) {}
     LineSegment(const std::string &raw_point1, const std::string &raw_point2) {
         // Separates each point by its x and y values
         std::vector<std::string> point1_xy = string_split(raw_point1, ",");
@@ -34,26 +78,428 @@ public:
         Point p2 = { std::stoi(point2_xy[0]), std::stoi(point2_xy[1]) };
 
         // Calculates the distance between the points in each axis
-        int delta_x = p2.x - p1.x; int mod_delta_x = std::abs(delta_x);
-        int delta_y = p2.y - p1.y; int mod_delta_y = std::abs(delta_y);
+        int64_t delta_x = (int64_t)p2.x - p1.x; int64_t mod_delta_x = std::abs(delta_x);
+        int64_t delta_y = (int64_t)p2.y - p1.y; int64_t mod_delta_y = std::abs(delta_y);
+
+        // Only horizontal, vertical, and 45 degrees diagonal lines are valid
+        if (mod_delta_x && mod_delta_y && mod_delta_x != mod_delta_y) {
+            throw std::invalid_argument("Line " + raw_point1 + " -> " + raw_point2 + " is not horizontal, vertical, or diagonal.");
+        }
+
+        // Only the start point, the direction, and the amount of points of the line are stored
+        _start = p1;
+        _step = { (delta_x > 0) - (delta_x < 0), (delta_y > 0) - (delta_y < 0) };
+        _length = std::max(mod_delta_x, mod_delta_y) + 1;
+    }
+
+    Points get_points() const { return { _start, _step, _length }; }
+
+    const Point& get_first_point() const { return _start; }
+    Point get_last_point() const { return { (int)(_start.x + _step.x * (_length - 1)), (int)(_start.y + _step.y * (_length - 1)) }; }
+
+    const Point& get_step() const { return _step; }
+    int64_t get_length() const { return _length; }
+
+    bool is_point() const { return _length == 1; }
+    bool is_vertical() const { return _step.x == 0; }
+    bool is_horizontal() const { return _step.y == 0; }
+};
+
+//
+// Increments a run of saturating counters, returning how many of them became overlapped
+// > Contiguous runs have no dependencies between counters, so they get vectorized by the compiler
+//
+int64_t increment_run(uint8_t* counters, int64_t stride, int64_t length) {
+    int64_t overlaps = 0;
+
+    if (stride == 1) {
+        for (int64_t i = 0; i < length; i++) {
+            overlaps += (counters[i] == 1);
+            counters[i] += (counters[i] < 2);
+        }
+    } else {
+        for (int64_t i = 0; i < length; i++) {
+            overlaps += (counters[i * stride] == 1);
+            counters[i * stride] += (counters[i * stride] < 2);
+        }
+    }
+
+    return overlaps;
+}
+
+//
+// Counter grid covering a whole bounding box
+// > Counters saturate at 2, since it only matters if a point is overlapped or not
+// > Overlaps are counted the moment a counter reaches 2, so no extra pass over the grid is needed
+//
+class DenseGrid
+{
+private:
+    Box _box;
+    std::vector<uint8_t> _counters;
+    int64_t _overlaps = 0;
+
+public:
+    DenseGrid() = delete;
+    DenseGrid(const Box& box) : _box(box), _counters(box.width() * box.height(), 0) {}
+
+    void add(const Point& point) {
+        uint8_t& counter = _counters[(point.y - _box.min.y) * _box.width() + (point.x - _box.min.x)];
+        _overlaps += (counter == 1);
+        counter += (counter < 2);
+    }
+
+    void add(const LineSegment& line) {
+        // Diagonal lines are added point by point
+        if (!line.is_horizontal() && !line.is_vertical()) {
+            for (const auto & point : line.get_points()) { add(point); }
+            return;
+        }
+
+        // Horizontal and vertical lines are added as a single run, starting from its top left point
+        Point first = line.get_first_point();
+        Point last = line.get_last_point();
+        Point start = { std::min(first.x, last.x), std::min(first.y, last.y) };
+
+        uint8_t* counters = &_counters[(start.y - _box.min.y) * _box.width() + (start.x - _box.min.x)];
+        _overlaps += increment_run(counters, line.is_horizontal() ? 1 : _box.width(), line.get_length());
+    }
+
+    int64_t get_overlaps() const { return _overlaps; }
+};
+
+//
+// Grid engine that splits the bounding box in tiles, each one rasterized and counted on its own
+// > Lines are first cut in pieces, one per tile they go through
+// > Every worker owns whole tiles, which it rasterizes one at a time in its own grid (no counter is ever shared)
+// > Tiles without any line are never allocated, so huge and sparse boxes are fine
+//
+class TiledRasterizer
+{
+private:
+    static constexpr int64_t TILE_SIZE = 1024;
 
-        // Calculates how many points the line will have
-        int n_points = std::max(mod_delta_x, mod_delta_y);
+    // Pieces of every tile are stored contiguously, tile after tile (offsets tell where each one starts)
+    std::vector<std::size_t> _offsets;
+    std::vector<LineSegment> _pieces;
+    std::vector<Box> _tile_boxes;
 
-        // Creates all the line points
-        for (int i = 0; i < n_points + 1; i++) {
-            _points.push_back({
-                p1.x + i * delta_x/n_points,
-                p1.y + i * delta_y/n_points
+private:
+    // Cuts a line in pieces, one per tile it goes through
+    template <typename Func>
+    static void _cut_line(const LineSegment& line, const Box& box, Func on_piece) {
+        const Point step = line.get_step();
+        Point point = line.get_first_point();
+
+        for (int64_t remaining = line.get_length(); remaining > 0; ) {
+            int64_t x = point.x - box.min.x;
+            int64_t y = point.y - box.min.y;
+
+            // Steps until the line leaves the current tile in each axis
+            int64_t steps_x = (step.x > 0) ? TILE_SIZE - x % TILE_SIZE : (step.x < 0) ? x % TILE_SIZE + 1 : remaining;
+            int64_t steps_y = (step.y > 0) ? TILE_SIZE - y % TILE_SIZE : (step.y < 0) ? y % TILE_SIZE + 1 : remaining;
+            int64_t run = std::min({ remaining, steps_x, steps_y });
+
+            on_piece(y / TILE_SIZE, x / TILE_SIZE, LineSegment(point, step, run));
+
+            point = { (int)(point.x + step.x * run), (int)(point.y + step.y * run) };
+            remaining -= run;
+        }
+    }
+
+public:
+    TiledRasterizer() = delete;
+    TiledRasterizer(const std::vector<LineSegment>& lines, const Box& box, bool with_diagonals) {
+        const int64_t tiles_per_row = (box.width() + TILE_SIZE - 1) / TILE_SIZE;
+
+        // Cuts all the lines (diagonal lines are only considered if requested)
+        std::vector<std::pair<int64_t, LineSegment>> pieces;
+        for (const auto & line : lines) {
+            if (!with_diagonals && !line.is_vertical() && !line.is_horizontal()) continue;
+
+            _cut_line(line, box, [&](int64_t tile_y, int64_t tile_x, const LineSegment& piece) {
+                pieces.push_back({ tile_y * tiles_per_row + tile_x, piece });
+            });
+        }
+
+        // Groups the pieces by tile
+        std::stable_sort(pieces.begin(), pieces.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+
+        for (std::size_t i = 0; i < pieces.size(); i++) {
+            const int64_t tile = pieces[i].first;
+
+            if (i == 0 || pieces[i - 1].first != tile) {
+                int64_t tile_x = tile % tiles_per_row, tile_y = tile / tiles_per_row;
+                Point min = { (int)(box.min.x + tile_x * TILE_SIZE), (int)(box.min.y + tile_y * TILE_SIZE) };
+                Point max = { (int)std::min<int64_t>(box.max.x, min.x + TILE_SIZE - 1), (int)std::min<int64_t>(box.max.y, min.y + TILE_SIZE - 1) };
+
+                _offsets.push_back(i);
+                _tile_boxes.push_back({ min, max });
+            }
+
+            _pieces.push_back(pieces[i].second);
+        }
+        _offsets.push_back(_pieces.size());
+    }
+
+    int64_t get_overlaps() const {
+        const std::size_t n_tiles = _tile_boxes.size();
+        const std::size_t n_threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, std::max<std::size_t>(n_tiles, 1));
+
+        // Every worker counts the overlaps of its own tiles
+        std::vector<int64_t> overlaps(n_threads, 0);
+
+        std::vector<std::thread> workers;
+        for (std::size_t w = 0; w < n_threads; w++) {
+            workers.emplace_back([this, w, n_tiles, n_threads, &overlaps](){
+                int64_t total = 0;
+
+                for (std::size_t tile = w; tile < n_tiles; tile += n_threads) {
+                    DenseGrid grid(_tile_boxes[tile]);
+                    for (std::size_t piece = _offsets[tile]; piece < _offsets[tile + 1]; piece++) { grid.add(_pieces[piece]); }
+                    total += grid.get_overlaps();
+                }
+
+                overlaps[w] = total;
             });
         }
+        for (auto & worker : workers) { worker.join(); }
+
+        return std::accumulate(overlaps.begin(), overlaps.end(), (int64_t)0);
+    }
+};
+
+
+//
+// Overlap counter that never rasterizes the lines, for coordinates too big for any grid
+// > Lines are grouped in families, each one with a value (key) that is constant along its lines
+// > Points covered twice by the same family come from collinear overlaps, which are merged line by line
+// > Points covered by two different families are the crossings between them, found with a sweep line
+//
+class SweepCounter
+{
+private:
+    enum Family { HORIZONTAL, VERTICAL, ASCENDING, DESCENDING, FAMILIES };
+
+    using Point64 = std::pair<int64_t, int64_t>;
+
+    // Range [lo, hi] of points of a line with a given key (the position along the line is its x, or y if vertical)
+    struct Interval {
+        int64_t key = 0, lo = 0, hi = 0;
+
+        bool operator<(Interval const &i) const {
+            return key < i.key || (key == i.key && lo < i.lo);
+        }
+    };
+
+    // Points covered by at least one line of the family
+    std::array<std::vector<Interval>, FAMILIES> _covered;
+
+    // Points covered by at least two lines of the family
+    std::array<std::vector<Interval>, FAMILIES> _doubled;
+
+    // Points covered by at least two families
+    std::vector<Point64> _crossings;
+
+private:
+    static Family _family_of(const LineSegment& line) {
+        if (line.is_horizontal()) return HORIZONTAL;
+        if (line.is_vertical()) return VERTICAL;
+        return (line.get_step().x == line.get_step().y) ? ASCENDING : DESCENDING;
+    }
+
+    static int64_t _key_of(const Family& family, const int64_t& x, const int64_t& y) {
+        switch (family) {
+            case HORIZONTAL: return y;
+            case VERTICAL: return x;
+            case ASCENDING: return x - y;
+            default: return x + y;
+        }
+    }
+
+    static int64_t _position_of(const Family& family, const int64_t& x, const int64_t& y) {
+        return (family == VERTICAL) ? y : x;
     }
 
-    std::vector<Point> get_points() const { return _points; }
+    static Point64 _point_of(const Family& family, const int64_t& key, const int64_t& position) {
+        switch (family) {
+            case HORIZONTAL: return { position, key };
+            case VERTICAL: return { key, position };
+            case ASCENDING: return { position, position - key };
+            default: return { position, key - position };
+        }
+    }
+
+    // Merges the (sorted) intervals of a family into the points covered once and twice
+    void _merge(const Family& family, const std::vector<Interval>& intervals) {
+        auto append = [](std::vector<Interval>& merged, const Interval& interval) {
+            if (!merged.empty() && merged.back().key == interval.key && merged.back().hi >= interval.lo - 1) {
+                merged.back().hi = std::max(merged.back().hi, interval.hi);
+            } else {
+                merged.push_back(interval);
+            }
+        };
+
+        for (std::size_t i = 0; i < intervals.size(); i++) {
+            const Interval& interval = intervals[i];
+
+            // Any interval overlapping the reach of the previous ones (of the same key) is overlapped
+            const bool same_key = !_covered[family].empty() && _covered[family].back().key == interval.key;
+            if (same_key && _covered[family].back().hi >= interval.lo) {
+                append(_doubled[family], { interval.key, interval.lo, std::min(interval.hi, _covered[family].back().hi) });
+            }
+
+            append(_covered[family], interval);
+        }
+    }
+
+    // Finds all the crossings between the lines of two families
+    // > In the coordinates (a, b) = (key of the second family, key of the first family), the lines of the
+    //   first family are horizontal and the ones of the second family are vertical
+    // > The sweep goes along a, keeping the active horizontals sorted by b, so each vertical only visits its crossings
+    void _find_crossings(const Family& first, const Family& second, const std::optional<int64_t>& parity) {
+        // Event types are sorted so that lines are inserted before, and removed after, the queries at the same a
+        enum EventType { INSERT, QUERY, REMOVE };
+        struct Event {
+            int64_t a = 0;
+            EventType type = INSERT;
+            int64_t b_lo = 0, b_hi = 0;
+
+            bool operator<(Event const &e) const {
+                return a < e.a || (a == e.a && type < e.type);
+            }
+        };
+
+        std::vector<Event> events;
+
+        // Diagonals of different directions only cross in a point of the grid if their keys have the same parity
+        auto in_parity = [&parity](const int64_t& key) { return !parity || (key & 1) == *parity; };
+
+        for (const auto & interval : _covered[first]) {
+            if (!in_parity(interval.key)) continue;
+
+            auto [x1, y1] = _point_of(first, interval.key, interval.lo);
+            auto [x2, y2] = _point_of(first, interval.key, interval.hi);
+            int64_t a1 = _key_of(second, x1, y1), a2 = _key_of(second, x2, y2);
+
+            events.push_back({ std::min(a1, a2), INSERT, interval.key, interval.key });
+            events.push_back({ std::max(a1, a2), REMOVE, interval.key, interval.key });
+        }
+
+        for (const auto & interval : _covered[second]) {
+            if (!in_parity(interval.key)) continue;
+
+            auto [x1, y1] = _point_of(second, interval.key, interval.lo);
+            auto [x2, y2] = _point_of(second, interval.key, interval.hi);
+            int64_t b1 = _key_of(first, x1, y1), b2 = _key_of(first, x2, y2);
+
+            events.push_back({ interval.key, QUERY, std::min(b1, b2), std::max(b1, b2) });
+        }
+
+        std::sort(events.begin(), events.end());
+
+        std::multiset<int64_t> active;
+        for (const auto & event : events) {
+            switch (event.type) {
+                case INSERT: active.insert(event.b_lo); break;
+                case REMOVE: active.erase(active.find(event.b_lo)); break;
+                case QUERY:
+                    for (auto b = active.lower_bound(event.b_lo); b != active.end() && *b <= event.b_hi; b++) {
+                        _crossings.push_back(_crossing_point(first, *b, second, event.a));
+                    }
+                    break;
+            }
+        }
+    }
+
+    // Point where two lines of different families meet
+    static Point64 _crossing_point(const Family& first, const int64_t& first_key, const Family& second, const int64_t& second_key) {
+        // Every family key is a linear function of (x, y), so the point is the solution of a 2x2 system
+        auto coefficients = [](const Family& family) -> Point64 {
+            switch (family) {
+                case HORIZONTAL: return { 0, 1 };
+                case VERTICAL: return { 1, 0 };
+                case ASCENDING: return { 1, -1 };
+                default: return { 1, 1 };
+            }
+        };
+
+        auto [a1, b1] = coefficients(first);
+        auto [a2, b2] = coefficients(second);
+        int64_t determinant = a1 * b2 - a2 * b1;
+
+        return { (first_key * b2 - second_key * b1) / determinant, (a1 * second_key - a2 * first_key) / determinant };
+    }
+
+    // Checks if a point is covered twice by a family
+    bool _is_doubled(const Family& family, const Point64& point) const {
+        const auto & [x, y] = point;
+        const Interval target = { _key_of(family, x, y), _position_of(family, x, y), 0 };
+
+        // Last interval starting at or before the point
+        auto interval = std::upper_bound(_doubled[family].begin(), _doubled[family].end(), target);
+        if (interval == _doubled[family].begin()) return false;
+        --interval;
+
+        return interval->key == target.key && interval->hi >= target.lo;
+    }
+
+public:
+    SweepCounter() = delete;
+    SweepCounter(const std::vector<LineSegment>& lines, bool with_diagonals) {
+        // Groups the lines by family
+        std::array<std::vector<Interval>, FAMILIES> intervals;
+        for (const auto & line : lines) {
+            const Family family = _family_of(line);
+            if (!with_diagonals && (family == ASCENDING || family == DESCENDING)) continue;
+
+            const Point first = line.get_first_point(), last = line.get_last_point();
+            const int64_t lo = _position_of(family, first.x, first.y), hi = _position_of(family, last.x, last.y);
+            intervals[family].push_back({ _key_of(family, first.x, first.y), std::min(lo, hi), std::max(lo, hi) });
+        }
+
+        // Collinear overlaps of every family
+        for (int family = 0; family < FAMILIES; family++) {
+            std::sort(intervals[family].begin(), intervals[family].end());
+            _merge((Family)family, intervals[family]);
+        }
+
+        // Crossings between every pair of families
+        for (int first = 0; first < FAMILIES; first++) {
+            for (int second = first + 1; second < FAMILIES; second++) {
+                if (first == ASCENDING && second == DESCENDING) {
+                    _find_crossings(ASCENDING, DESCENDING, 0);
+                    _find_crossings(ASCENDING, DESCENDING, 1);
+                } else {
+                    _find_crossings((Family)first, (Family)second, std::nullopt);
+                }
+            }
+        }
 
-    bool is_point() { return _points.size() == 1; }
-    bool is_vertical() const { return _points[0].x == _points[1].x; }
-    bool is_horizontal() const { return _points[0].y == _points[1].y; }
+        std::sort(_crossings.begin(), _crossings.end());
+        _crossings.erase(std::unique(_crossings.begin(), _crossings.end()), _crossings.end());
+    }
+
+    int64_t get_overlaps() const {
+        int64_t overlaps = 0;
+
+        // Points covered twice by the same family
+        for (const auto & doubled : _doubled) {
+            for (const auto & interval : doubled) { overlaps += interval.hi - interval.lo + 1; }
+        }
+
+        // Crossings are overlaps too, but some of them were already counted
+        // > The ones covered twice by a single family were counted once (fine)
+        // > The ones covered twice by several families were counted once per family (only one is fine)
+        for (const auto & crossing : _crossings) {
+            int families = 0;
+            for (int family = 0; family < FAMILIES; family++) { families += _is_doubled((Family)family, crossing); }
+
+            overlaps += (families == 0) ? 1 : 1 - families;
+        }
+
+        return overlaps;
+    }
 };
 
 
@@ -79,60 +525,76 @@ std::vector<LineSegment> parse_inputs(int argc, char* argv[]) {
 
 
 
+Box find_bounding_box(const std::vector<LineSegment>& lines) {
+    Box box = { lines.front().get_first_point(), lines.front().get_first_point() };
+
+    for (const auto & line : lines) {
+        for (const auto & point : { line.get_first_point(), line.get_last_point() }) {
+            box.min = { std::min(box.min.x, point.x), std::min(box.min.y, point.y) };
+            box.max = { std::max(box.max.x, point.x), std::max(box.max.y, point.y) };
+        }
+    }
+
+    return box;
+}
+
+int64_t count_overlaps(const std::vector<LineSegment>& lines, const Box& box, bool with_diagonals) {
+    return TiledRasterizer(lines, box, with_diagonals).get_overlaps();
+}
+
+int64_t count_overlaps(const std::vector<LineSegment>& lines, const Box& box, bool with_diagonals, const std::string& engine) {
+    if (engine == "--grid") return count_overlaps(lines, box, with_diagonals);
+    if (engine == "--sweep") return SweepCounter(lines, with_diagonals).get_overlaps();
+
+    if (engine == "--check") {
+        int64_t grid_overlaps = count_overlaps(lines, box, with_diagonals);
+        int64_t sweep_overlaps = SweepCounter(lines, with_diagonals).get_overlaps();
+
+        if (grid_overlaps != sweep_overlaps) {
+            throw std::runtime_error("Engines disagree: grid found " + std::to_string(grid_overlaps) + " overlaps, sweep found " + std::to_string(sweep_overlaps) + ".");
+        }
+        return grid_overlaps;
+    }
+
+    throw std::invalid_argument("Unknown engine " + engine + ". Use --grid, --sweep, or --check.");
+}
+
+
+
 int main(int argc, char* argv[]) {
     // Common
     const auto LINES = parse_inputs(argc, argv);
+    const Box BOX = find_bounding_box(LINES);
+
+    // The grid engine is used by default
+    // > "--sweep" counts the overlaps without any grid (for coordinates too big to rasterize)
+    // > "--check" runs both engines and makes sure they agree
+    const std::string ENGINE = (argc > 2) ? argv[2] : "--grid";
 
     // Part One algorithms
-    int result_1 = 0;
+    int64_t result_1 = 0;
 
     float part_1_elapsed_time = time_block( [&](){
-        // Map that will store all the points of each line and count them
-        std::map<Point, int> points_map;
-
-        for (const auto & line : LINES) {
-            // We dont care about lines other than vertical and horizontal
-            if (!line.is_vertical() && !line.is_horizontal()) continue;
-
-            // Adds each point to the map
-            // > It is safe to do this due to map operator [] specification
-            //   > If no key is present, it creates it with a default value invoke
-            for (auto point : line.get_points()) { ++points_map[point]; }
-        }
-
-        for (const auto & [point, count] : points_map) {
-            if (count > 1) result_1++;
-        }
+        // We dont care about lines other than vertical and horizontal
+        result_1 = count_overlaps(LINES, BOX, false, ENGINE);
     });
     
     // Part One visualization
     printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
-    printf("   There are %d where at least two lines overlap.\n", result_1);
+    printf("   There are %ld where at least two lines overlap.\n", result_1);
 
 
 
     // Part Two algorithms
-    int result_2 = 0;
+    int64_t result_2 = 0;
 
     float part_2_elapsed_time = time_block( [&](){
-        // Map that will store all the points of each line and count them
-        std::map<Point, int> points_map;
-
-        for (const auto & line : LINES) {
-            // Adds each point to the map
-            // > It is safe to do this due to map operator [] specification
-            //   > If no key is present, it creates it with a default value invoke
-            for (auto point : line.get_points()) { ++points_map[point]; }
-        }
-
-        for (const auto & [point, count] : points_map) {
-            if (count > 1) result_2++;
-        }
+        result_2 = count_overlaps(LINES, BOX, true, ENGINE);
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
-    printf("   There are %d where at least two lines overlap.\n", result_2);
+    printf("   There are %ld where at least two lines overlap.\n", result_2);
 
     return 0;
 }
@@ -4,7 +4,7 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
-#include <map>
+#include <array>
 #include <cstdint>
 
 #include "../common/utils.hpp"
@@ -36,45 +36,338 @@ std::vector<int> parse_inputs(int argc, char* argv[]) {
     return values;
 }
 
-int64_t simulate_glowfish_growth(const int & sim_time, const std::vector<int> & fishes) {
-    // Creates a map with all the glowfishes timer possibilities, and the amount on each timer
-    std::map<int64_t, int64_t> glowfish_timers;
-    for (const auto & fish : fishes) { ++glowfish_timers[fish]; }
+//
+// Amount of glowfishes on each timer (index is the timer)
+//
+using GlowfishTimers = std::array<uint64_t, MAX_GLOWFISH_TIMER + 2>;
 
-    // Actual simulation
-    for (int day = 1; day <= sim_time; day++) {
-        // Temporary variable to 
-        int64_t timer_0_cache = glowfish_timers[0];
+GlowfishTimers count_glowfish_timers(const std::vector<int> & fishes) {
+    GlowfishTimers timers = {};
+    for (const auto & fish : fishes) { ++timers.at(fish); }
+    return timers;
+}
+
+//
+// Advances the timers from one day to another
+// > The timers are a ring buffer, whose head (the 0 timer) moves one position every day
+// > The glowfishes in the head become the newborns of the next day (timer MAX+1) just by moving the head
+// > They are also the ones restarting at timer MAX-1, which is the only addition needed per day
+//
+constexpr void advance_glowfish_timers(GlowfishTimers & timers, int64_t from_day, int64_t to_day) {
+    for (int64_t day = from_day; day < to_day; day++) {
+        const int head = day % timers.size();
+        timers[(head + MAX_GLOWFISH_TIMER) % timers.size()] += timers[head];
+    }
+}
 
-        // Decreases all the timers
-        for (int i = 0; i < MAX_GLOWFISH_TIMER + 1; i++) { glowfish_timers[i] = glowfish_timers[i+1]; }
+constexpr uint64_t count_glowfishes(const GlowfishTimers & timers) {
+    uint64_t fishes_amount = 0;
+    for (const auto & amount : timers) { fishes_amount += amount; }
+    return fishes_amount;
+}
 
-        // Handles the 0 timer glowfishes
-        // > The already existent go to position MAX-1
-        // > The newborns got to position Max+1 with same amount as the ones that created them
-        glowfish_timers[MAX_GLOWFISH_TIMER-1] += timer_0_cache;
-        glowfish_timers[MAX_GLOWFISH_TIMER+1] = timer_0_cache;
+constexpr uint64_t simulate_glowfish_growth(const int & sim_time, GlowfishTimers timers) {
+    advance_glowfish_timers(timers, 0, sim_time);
+    return count_glowfishes(timers);
+}
+
+//
+// Simulates the growth up to several simulation times at once (sorted in ascending order)
+// > A single forward simulation is done, taking note of the amount of glowfishes at each requested time
+//
+std::vector<uint64_t> simulate_glowfish_growth(const std::vector<int64_t> & sim_times, GlowfishTimers timers) {
+    if (!std::is_sorted(sim_times.begin(), sim_times.end())) throw std::invalid_argument("Simulation times must be sorted.");
+    if (!sim_times.empty() && sim_times.front() < 0) throw std::invalid_argument("Simulation times must not be negative.");
+
+    std::vector<uint64_t> fishes_amounts;
+    fishes_amounts.reserve(sim_times.size());
+
+    // Same ring buffer simulation, resumed from the previous requested time
+    int64_t day = 0;
+    for (const auto & sim_time : sim_times) {
+        advance_glowfish_timers(timers, day, sim_time);
+        day = sim_time;
+
+        fishes_amounts.push_back(count_glowfishes(timers));
     }
 
-    // Counts all the existent glowfishes in the current day
-    int64_t fishes_amout = 0;
-    for (const auto & [timer, amount] : glowfish_timers) { fishes_amout += amount; }
+    return fishes_amounts;
+}
+
+// Example from the instructions (3,4,3,1,2), computed at compile time
+static_assert(simulate_glowfish_growth(18, {0, 1, 1, 2, 1, 0, 0, 0, 0}) == 26);
+static_assert(simulate_glowfish_growth(80, {0, 1, 1, 2, 1, 0, 0, 0, 0}) == 5934);
+
+
+//
+// Unsigned integer without any size limit
+// > Stored as base 2^32 limbs, the first limb being the least significant one
+//
+class BigUnsigned
+{
+private:
+    std::vector<uint32_t> _limbs;
+
+private:
+    void _trim() { while (!_limbs.empty() && _limbs.back() == 0) { _limbs.pop_back(); } }
+
+public:
+    BigUnsigned(uint64_t value = 0) {
+        for (; value; value >>= 32) { _limbs.push_back((uint32_t)value); }
+    }
+
+    BigUnsigned operator+(const BigUnsigned& other) const {
+        BigUnsigned result;
+        result._limbs.resize(std::max(_limbs.size(), other._limbs.size()) + 1, 0);
+
+        uint64_t carry = 0;
+        for (std::size_t i = 0; i < result._limbs.size(); i++) {
+            uint64_t sum = carry;
+            if (i < _limbs.size()) { sum += _limbs[i]; }
+            if (i < other._limbs.size()) { sum += other._limbs[i]; }
+            result._limbs[i] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+
+        result._trim();
+        return result;
+    }
 
-    return fishes_amout;
+    BigUnsigned operator*(const BigUnsigned& other) const {
+        BigUnsigned result;
+        if (_limbs.empty() || other._limbs.empty()) { return result; }
+
+        result._limbs.resize(_limbs.size() + other._limbs.size(), 0);
+
+        // Schoolbook multiplication
+        for (std::size_t i = 0; i < _limbs.size(); i++) {
+            uint64_t carry = 0;
+            for (std::size_t j = 0; j < other._limbs.size(); j++) {
+                uint64_t product = (uint64_t)_limbs[i] * other._limbs[j] + result._limbs[i + j] + carry;
+                result._limbs[i + j] = (uint32_t)product;
+                carry = product >> 32;
+            }
+            result._limbs[i + other._limbs.size()] = (uint32_t)carry;
+        }
+
+        result._trim();
+        return result;
+    }
+
+    std::string to_string() const {
+        if (_limbs.empty()) { return "0"; }
+
+        // Repeated divisions by 10^9, which give the decimal digits in groups of 9 (least significant first)
+        std::vector<uint32_t> limbs = _limbs;
+        std::vector<uint32_t> groups;
+        while (!limbs.empty()) {
+            uint64_t remainder = 0;
+            for (auto limb = limbs.rbegin(); limb != limbs.rend(); limb++) {
+                uint64_t value = (remainder << 32) | *limb;
+                *limb = (uint32_t)(value / 1000000000);
+                remainder = value % 1000000000;
+            }
+            groups.push_back((uint32_t)remainder);
+            while (!limbs.empty() && limbs.back() == 0) { limbs.pop_back(); }
+        }
+
+        std::string output = std::to_string(groups.back());
+        for (auto group = groups.rbegin() + 1; group != groups.rend(); group++) {
+            std::string digits = std::to_string(*group);
+            output += std::string(9 - digits.size(), '0') + digits;
+        }
+
+        return output;
+    }
+};
+
+//
+// Arithmetic backends for the growth matrix
+//
+struct ModularArithmetic {
+    using Value = uint64_t;
+
+    uint64_t modulus = 1000000007;
+
+    Value from(const uint64_t& value) const { return value % modulus; }
+    Value add(const Value& a, const Value& b) const { return (Value)(((unsigned __int128)a + b) % modulus); }
+    Value multiply(const Value& a, const Value& b) const { return (Value)(((unsigned __int128)a * b) % modulus); }
+    std::string to_string(const Value& value) const { return std::to_string(value); }
+};
+
+struct Int128Arithmetic {
+    using Value = unsigned __int128;
+
+    Value from(const uint64_t& value) const { return value; }
+
+    Value add(const Value& a, const Value& b) const {
+        Value result;
+        if (__builtin_add_overflow(a, b, &result)) { throw std::overflow_error("The amount of glowfishes does not fit in 128 bits."); }
+        return result;
+    }
+
+    Value multiply(const Value& a, const Value& b) const {
+        Value result;
+        if (__builtin_mul_overflow(a, b, &result)) { throw std::overflow_error("The amount of glowfishes does not fit in 128 bits."); }
+        return result;
+    }
+
+    std::string to_string(Value value) const {
+        std::string output;
+        do { output.insert(output.begin(), '0' + (char)(value % 10)); value /= 10; } while (value);
+        return output;
+    }
+};
+
+struct BigArithmetic {
+    using Value = BigUnsigned;
+
+    Value from(const uint64_t& value) const { return value; }
+    Value add(const Value& a, const Value& b) const { return a + b; }
+    Value multiply(const Value& a, const Value& b) const { return a * b; }
+    std::string to_string(const Value& value) const { return value.to_string(); }
+};
+
+//
+// Simulates the growth as powers of the daily transition matrix (applied to the timers)
+// > Each day is a linear map of the timers, so simulating n days is applying the matrix power n
+// > The power is found by repeated squaring, which takes O(log n) matrix products
+//
+template <typename Arithmetic>
+class GrowthMatrix
+{
+public:
+    using Value = typename Arithmetic::Value;
+
+    static constexpr int SIZE = MAX_GLOWFISH_TIMER + 2;
+
+    using Matrix = std::array<std::array<Value, SIZE>, SIZE>;
+    using Vector = std::array<Value, SIZE>;
+
+private:
+    Arithmetic _arithmetic;
+
+    // Transition matrix raised to the powers of 2 (only computed once needed)
+    std::vector<Matrix> _powers;
+
+private:
+    const Matrix& _get_power_of_two(const int64_t& bit) {
+        while (_powers.size() <= bit) { _powers.push_back(_multiply(_powers.back(), _powers.back())); }
+        return _powers[bit];
+    }
+
+    Matrix _multiply(const Matrix& a, const Matrix& b) const {
+        Matrix result;
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE; j++) {
+                Value sum = _arithmetic.from(0);
+                for (int k = 0; k < SIZE; k++) { sum = _arithmetic.add(sum, _arithmetic.multiply(a[i][k], b[k][j])); }
+                result[i][j] = sum;
+            }
+        }
+        return result;
+    }
+
+    Vector _multiply(const Matrix& a, const Vector& v) const {
+        Vector result;
+        for (int i = 0; i < SIZE; i++) {
+            Value sum = _arithmetic.from(0);
+            for (int k = 0; k < SIZE; k++) { sum = _arithmetic.add(sum, _arithmetic.multiply(a[i][k], v[k])); }
+            result[i] = sum;
+        }
+        return result;
+    }
+
+public:
+    GrowthMatrix(const Arithmetic& arithmetic = {}) : _arithmetic(arithmetic) {
+        Matrix transition;
+        for (auto & row : transition) { row.fill(_arithmetic.from(0)); }
+
+        // Every timer decreases by one
+        for (int i = 0; i < SIZE - 1; i++) { transition[i][i+1] = _arithmetic.from(1); }
+
+        // The 0 timer glowfishes restart at MAX-1 and create the same amount of newborns at MAX+1
+        transition[MAX_GLOWFISH_TIMER-1][0] = _arithmetic.from(1);
+        transition[MAX_GLOWFISH_TIMER+1][0] = _arithmetic.from(1);
+
+        _powers.push_back(transition);
+    }
+
+    // Simulates the growth up to several simulation times at once (sorted in ascending order)
+    // > The state moves forward from one requested time to the next, so the powers of 2 are computed once and reused
+    std::vector<Value> simulate(const std::vector<int64_t>& sim_times, const GlowfishTimers& timers) {
+        if (!std::is_sorted(sim_times.begin(), sim_times.end())) throw std::invalid_argument("Simulation times must be sorted.");
+        if (!sim_times.empty() && sim_times.front() < 0) throw std::invalid_argument("Simulation times must not be negative.");
+
+        Vector state;
+        for (int i = 0; i < SIZE; i++) { state[i] = _arithmetic.from(timers[i]); }
+
+        std::vector<Value> fishes_amounts;
+        fishes_amounts.reserve(sim_times.size());
+
+        int64_t day = 0;
+        for (const auto & sim_time : sim_times) {
+            // Applies the powers of 2 of the transition matrix that make up the time since the previous request
+            for (int64_t delta = sim_time - day, bit = 0; delta > 0; delta >>= 1, bit++) {
+                if (delta & 1) { state = _multiply(_get_power_of_two(bit), state); }
+            }
+            day = sim_time;
+
+            // Counts all the existent glowfishes
+            Value fishes_amount = _arithmetic.from(0);
+            for (const auto & amount : state) { fishes_amount = _arithmetic.add(fishes_amount, amount); }
+            fishes_amounts.push_back(fishes_amount);
+        }
+
+        return fishes_amounts;
+    }
+
+    std::string to_string(const Value& value) const { return _arithmetic.to_string(value); }
+};
+
+//
+// Simulates the growth up to several simulation times with the arithmetic backend selected by name
+// > "--mod=<p>" counts modulo p, "--int128" counts exactly up to 128 bits, and "--big" counts exactly without limit
+//
+template <typename Arithmetic>
+std::vector<std::string> simulate_glowfish_growth(const std::vector<int64_t> & sim_times, const GlowfishTimers & timers, const Arithmetic & arithmetic) {
+    GrowthMatrix<Arithmetic> engine(arithmetic);
+
+    std::vector<std::string> output;
+    for (const auto & fishes_amount : engine.simulate(sim_times, timers)) { output.push_back(engine.to_string(fishes_amount)); }
+    return output;
 }
 
+std::vector<std::string> simulate_glowfish_growth(const std::vector<int64_t> & sim_times, const GlowfishTimers & timers, const std::string & backend) {
+    if (backend.rfind("--mod=", 0) == 0) {
+        const uint64_t modulus = std::stoull(backend.substr(6));
+        if (modulus == 0) throw std::invalid_argument("The modulus must be positive.");
+
+        return simulate_glowfish_growth(sim_times, timers, ModularArithmetic{modulus});
+    }
+    if (backend == "--int128") return simulate_glowfish_growth(sim_times, timers, Int128Arithmetic{});
+    if (backend == "--big") return simulate_glowfish_growth(sim_times, timers, BigArithmetic{});
+
+    throw std::invalid_argument("Unknown arithmetic " + backend + ". Use --mod=<p>, --int128, or --big.");
+}
 
 
 int main(int argc, char* argv[]) {
     // Common
     const auto numbers = parse_inputs(argc, argv);
+    const auto timers = count_glowfish_timers(numbers);
+
+    // Both parts are answered by a single simulation
+    const int SIMULATION_TIME_1 = 80;
+    const int SIMULATION_TIME_2 = 256;
+    std::vector<uint64_t> results;
 
     // Part One algorithms
-    int SIMULATION_TIME_1 = 80;
-    int64_t result_1 = 0;
+    uint64_t result_1 = 0;
 
     float part_1_elapsed_time = time_block( [&](){
-        result_1 = simulate_glowfish_growth(SIMULATION_TIME_1, numbers);
+        results = simulate_glowfish_growth({SIMULATION_TIME_1, SIMULATION_TIME_2}, timers);
+        result_1 = results[0];
     });
     
     // Part One visualization
@@ -84,16 +377,39 @@ int main(int argc, char* argv[]) {
 
 
     // Part Two algorithms
-    int SIMULATION_TIME_2 = 256;
-    int64_t result_2 = 0;
+    uint64_t result_2 = 0;
 
     float part_2_elapsed_time = time_block( [&](){
-        result_2 = simulate_glowfish_growth(SIMULATION_TIME_2, numbers);
+        // The simulation already went up to this time in Part One
+        result_2 = results[1];
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
     printf("   After %d days there are a total of %lu glowfishes.\n", SIMULATION_TIME_2, result_2);
 
+
+
+    // Custom simulation times (only if requested)
+    // > Usage: <input> <days>[,<days>...] [--mod=<p> | --int128 | --big]
+    if (argc > 2) {
+        std::vector<int64_t> SIMULATION_TIMES_3;
+        for (const auto & value : string_split(argv[2], ",")) { SIMULATION_TIMES_3.push_back(std::stoll(value)); }
+        std::sort(SIMULATION_TIMES_3.begin(), SIMULATION_TIMES_3.end());
+
+        const std::string BACKEND = (argc > 3) ? argv[3] : "--int128";
+        std::vector<std::string> results_3;
+
+        float part_3_elapsed_time = time_block( [&](){
+            results_3 = simulate_glowfish_growth(SIMULATION_TIMES_3, timers, BACKEND);
+        });
+
+        // Custom simulation visualization
+        printf("\n> Custom < (%f seconds)\n", part_3_elapsed_time);
+        for (int i = 0; i < SIMULATION_TIMES_3.size(); i++) {
+            printf("   After %ld days there are a total of %s glowfishes (%s).\n", SIMULATION_TIMES_3[i], results_3[i].c_str(), BACKEND.c_str());
+        }
+    }
+
     return 0;
 }
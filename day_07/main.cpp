@@ -3,11 +3,10 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
-#include <map>
-#include <unordered_map>
 #include <cstdint>
-#include <set>
 #include <limits>
+#include <numeric>
+#include <tuple>
 
 #include "../common/utils.hpp"
 
@@ -24,111 +23,296 @@ std::vector<int> parse_inputs(int argc, char* argv[]) {
     std::ifstream input_file(std::string(argv[1]), std::ios::in);
 
     // There is only a single line with all the values
-    std::string line;
-    std::getline(input_file, line);
+    // > Values are read one by one from the stream (big swarms have millions of them)
+    std::string value;
+    while (std::getline(input_file, value, ',')) {
+        if (value.find_first_not_of(" \n") != std::string::npos) { values.push_back(std::stoi(value)); }
+    }
 
-    // Separates all the values
-    std::vector<std::string> str_values = string_split(line, ",");
+    return values;
+}
 
-    // Converts all the values from string to integer
-    std::transform(str_values.begin(), str_values.end(), std::back_inserter(values), [](const std::string &val){ return std::stoi(val); });
+//
+// Dense histogram of the crab positions (index i has the amount of crabs at min_position + i)
+//
+struct CrabHistogram {
+    int min_position = 0;
+    std::vector<int64_t> counts;
+};
 
-    return values;
+CrabHistogram build_histogram(const std::vector<int>& values) {
+    CrabHistogram histogram;
+    histogram.min_position = *std::min_element(values.begin(), values.end());
+
+    const int max_position = *std::max_element(values.begin(), values.end());
+    histogram.counts.assign((int64_t)max_position - histogram.min_position + 1, 0);
+    for (const auto & value : values) { ++histogram.counts[value - histogram.min_position]; }
+
+    return histogram;
 }
 
-std::tuple<int, int> find_best_consumption(std::map<int, int>& distribution, std::unordered_map<int, int>& consumption_model) {
-    // Outputs
-    int best_target = 0;
-    int best_consumption = std::numeric_limits<int>::max();
+//
+// Converts a consumption into its decimal representation (also works for 128 bits)
+//
+template <typename Cost>
+std::string to_string(Cost value) {
+    if (value < 0) return "-" + to_string<Cost>(-value);
 
-    // Gets the minimum and maximum positions in the list of numbers
-    auto [min_position, _1] = *std::min_element(distribution.begin(), distribution.end());
-    auto [max_position, _2] = *std::max_element(distribution.begin(), distribution.end());
+    std::string output;
+    do { output.insert(output.begin(), '0' + (char)(value % 10)); value /= 10; } while (value);
+    return output;
+}
+
+//
+// Total consumption of all the crabs to reach a target, given the consumption of each distance
+// > Goes through the crab positions themselves (O(n), no matter how far apart they are)
+// > The distance is taken without branches, so the loop gets vectorized
+//
+template <typename Cost, typename Consumption>
+Cost sum_consumption(const std::vector<int>& values, const int64_t& target, Consumption consumption) {
+    Cost total = 0;
+
+    for (const auto & value : values) {
+        const int64_t difference = value - target;
+        const Cost distance = std::max(difference, -difference);
+        total += consumption(distance);
+    }
+
+    return total;
+}
+
+//
+// Fuel consumption model, made of polynomial pieces of the distance travelled
+// > In its range of distances, a piece makes each crab consume (a + b*d + c*d^2) / divisor, which must be an integer
+// > The whole model must be convex in the distance, which is what makes the search for the best target possible
+//
+struct FuelPiece {
+    int64_t min_distance = 0, max_distance = std::numeric_limits<int>::max();
+    int64_t a = 0, b = 0, c = 0, divisor = 1;
+};
+
+using FuelModel = std::vector<FuelPiece>;
+
+// Every step costs 1
+FuelModel linear_model() { return { {0, std::numeric_limits<int>::max(), 0, 1, 0, 1} }; }
+
+// Every step costs 1 more than the previous one: d*(d+1)/2
+FuelModel triangular_model() { return { {0, std::numeric_limits<int>::max(), 0, 1, 1, 2} }; }
+
+// Costs the square of the distance
+FuelModel quadratic_model() { return { {0, std::numeric_limits<int>::max(), 0, 0, 1, 1} }; }
+
+// Every step costs 1 more than the previous one, until a step costs the cap (all the others cost the same)
+FuelModel capped_model(int64_t cap) {
+    return {
+        {0, cap, 0, 1, 1, 2},
+        {cap + 1, std::numeric_limits<int>::max(), -cap * (cap - 1) / 2, cap, 0, 1}
+    };
+}
 
-    // Goes through all the possible positions
-    for (int i = min_position ; i <= max_position; i++) {
-        int total = 0;
+FuelModel parse_fuel_model(const std::string& name) {
+    if (name == "linear") return linear_model();
+    if (name == "triangular") return triangular_model();
+    if (name == "quadratic") return quadratic_model();
+    if (name.rfind("capped:", 0) == 0) return capped_model(std::stoll(name.substr(7)));
 
-        // Sums all the fuel amounts
-        for (const auto & [value, amount] : distribution) {
-            int distance = std::abs(i - value);
-            total += consumption_model[distance] * amount;
+    throw std::invalid_argument("Unknown fuel model " + name + ". Use linear, triangular, quadratic, or capped:<cap>.");
+}
+
+//
+// Finds the best target for any convex fuel model
+// > Positions are kept in a dense histogram, with prefix sums of the amount of crabs, of x, and of x^2
+// > The consumption of all the crabs in a range of positions is then a polynomial of these sums, so a target costs O(1)
+// > Since the total consumption is convex, the best target is found by a binary search on its slope
+// > All the sums use the Cost type (128 bits by default, since sums of x^2 grow fast with big swarms)
+//
+template <typename Cost = __int128>
+class AlignmentSolver
+{
+private:
+    int _min_position, _max_position;
+
+    // Prefix sums, where index i has the sum of all positions below _min_position + i
+    std::vector<Cost> _count, _sum, _sum_squares;
+
+private:
+    // Amount of crabs, sum of x, and sum of x^2 between two positions (both included)
+    std::tuple<Cost, Cost, Cost> _range(int64_t lo, int64_t hi) const {
+        lo = std::max<int64_t>(lo, _min_position) - _min_position;
+        hi = std::min<int64_t>(hi, _max_position) - _min_position + 1;
+        if (lo >= hi) return {0, 0, 0};
+
+        return { _count[hi] - _count[lo], _sum[hi] - _sum[lo], _sum_squares[hi] - _sum_squares[lo] };
+    }
+
+public:
+    AlignmentSolver() = delete;
+    AlignmentSolver(const CrabHistogram& histogram) {
+        _min_position = histogram.min_position;
+        _max_position = histogram.min_position + (int64_t)histogram.counts.size() - 1;
+
+        const auto & counts = histogram.counts;
+        _count.assign(counts.size() + 1, 0);
+        _sum.assign(counts.size() + 1, 0);
+        _sum_squares.assign(counts.size() + 1, 0);
+
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            const Cost x = _min_position + (int64_t)i;
+            _count[i + 1] = _count[i] + counts[i];
+            _sum[i + 1] = _sum[i] + counts[i] * x;
+            _sum_squares[i + 1] = _sum_squares[i] + counts[i] * x * x;
         }
+    }
 
-        // Updates the best fuel and target
-        // > If not a better result was found we can break the search (we found the best!)
-        // > This is possible because the distribution is ordered
-        if (best_consumption > total) {
-            best_consumption = total;
-            best_target = i;
-        } else break;
+    Cost get_consumption(const int64_t& target, const FuelModel& model) const {
+        const Cost t = target;
+        Cost total = 0;
 
+        for (const auto & piece : model) {
+            // Crabs to the right of the target (d = x - t)
+            auto [n_r, x_r, xx_r] = _range(target + piece.min_distance, target + piece.max_distance);
+            Cost right = piece.a * n_r + piece.b * (x_r - t * n_r) + piece.c * (xx_r - 2 * t * x_r + t * t * n_r);
+
+            // Crabs to the left of the target (d = t - x), not counting the target itself twice
+            auto [n_l, x_l, xx_l] = _range(target - piece.max_distance, target - std::max<int64_t>(piece.min_distance, 1));
+            Cost left = piece.a * n_l + piece.b * (t * n_l - x_l) + piece.c * (xx_l - 2 * t * x_l + t * t * n_l);
+
+            total += (right + left) / piece.divisor;
+        }
+
+        return total;
     }
 
-    return {best_consumption, best_target};
+    std::tuple<Cost, int> find_best_consumption(const FuelModel& model) const {
+        // First target whose next one is not better (the smallest of the best targets)
+        int64_t lo = _min_position, hi = _max_position;
+        while (lo < hi) {
+            int64_t mid = lo + (hi - lo) / 2;
+            if (get_consumption(mid + 1, model) >= get_consumption(mid, model)) { hi = mid; } else { lo = mid + 1; }
+        }
+
+        return { get_consumption(lo, model), (int)lo };
+    }
+};
+
+//
+// Closed form solutions of the alignment (no search over the positions, no consumption tables)
+// > The linear consumption is minimized at the median of the positions
+//
+template <typename Cost = int64_t>
+std::tuple<Cost, int> find_best_linear_consumption(std::vector<int> values) {
+    // Lower median (for an even amount of values, every target between both medians is as good)
+    auto median = values.begin() + (values.size() - 1) / 2;
+    std::nth_element(values.begin(), median, values.end());
+    const int target = *median;
+
+    return { sum_consumption<Cost>(values, target, [](const Cost& distance){ return distance; }), target };
 }
 
+//
+// > The triangular consumption is minimized within half a position of the mean, so only its neighbours are checked
+//
+template <typename Cost = int64_t>
+std::tuple<Cost, int> find_best_triangular_consumption(const std::vector<int>& values) {
+    const int64_t sum = std::accumulate(values.begin(), values.end(), (int64_t)0);
+    const int64_t mean_floor = sum / (int64_t)values.size() - (sum % (int64_t)values.size() < 0);
+
+    int best_target = 0;
+    Cost best_consumption = std::numeric_limits<Cost>::max();
 
+    for (int64_t target = mean_floor - 1; target <= mean_floor + 2; target++) {
+        Cost total = sum_consumption<Cost>(values, target, [](const Cost& distance){ return distance * (distance + 1) / 2; });
+
+        if (best_consumption > total) {
+            best_consumption = total;
+            best_target = target;
+        }
+    }
+
+    return {best_consumption, best_target};
+}
 
 int main(int argc, char* argv[]) {
     // Common
     const auto values = parse_inputs(argc, argv);
 
-    // Creates a distribution model of the values
-    // > We want this distribution to be ordered -> map
-    std::map<int, int> distribution;
-    for (const auto & value : values) { ++distribution[value]; }
+    // Options
+    // > "--closed-form" uses the closed form solutions instead of the search
+    // > "--model=<name>" also finds the best alignment for a custom fuel model
+    bool CLOSED_FORM = false;
+    std::string CUSTOM_MODEL;
+    for (int i = 2; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--closed-form") { CLOSED_FORM = true; }
+        else if (option.rfind("--model=", 0) == 0) { CUSTOM_MODEL = option.substr(8); }
+        else { throw std::invalid_argument("Unknown option " + option + "."); }
+    }
 
-    // Gets the minimum and maximum elements in the list of numbers
-    int min_number = *std::min_element(values.begin(), values.end());
-    int max_number = *std::max_element(values.begin(), values.end());
+    // Only the search needs the histogram (its size is the range of positions, which the closed forms never pay for)
+    const CrabHistogram histogram = (!CLOSED_FORM || !CUSTOM_MODEL.empty()) ? build_histogram(values) : CrabHistogram{};
 
     // Part One algorithms
-    int result_fuel_1;
+    std::string result_fuel_1;
     int result_target_1;
 
     float part_1_elapsed_time = time_block( [&](){
-        // Creates the total consumption from a point to all other points
-        std::unordered_map<int, int> fuel_consumption;
-        for (int i = min_number; i <= max_number - min_number; i++) { fuel_consumption[i] = i; }
-
-        // Actual simulation
-        auto [best_consumption, best_target] = find_best_consumption(distribution, fuel_consumption);
-
-        // Updates the results
-        result_fuel_1 = best_consumption;
-        result_target_1 = best_target;
+        if (CLOSED_FORM) {
+            auto [best_consumption, best_target] = find_best_linear_consumption(values);
+            result_fuel_1 = to_string(best_consumption);
+            result_target_1 = best_target;
+        } else {
+            auto [best_consumption, best_target] = AlignmentSolver(histogram).find_best_consumption(linear_model());
+            result_fuel_1 = to_string(best_consumption);
+            result_target_1 = best_target;
+        }
     });
     
     // Part One visualization
     printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
     printf("   The best horizontal position that the crabs can align is %d.\n", result_target_1);
-    printf("   The total consumption is %d of fuel.\n", result_fuel_1);
+    printf("   The total consumption is %s of fuel.\n", result_fuel_1.c_str());
 
 
 
     // Part Two algorithms
-    int result_fuel_2;
+    std::string result_fuel_2;
     int result_target_2;
 
     float part_2_elapsed_time = time_block( [&](){
-        // Creates the total consumption from a point to all other points
-        std::unordered_map<int, int> fuel_consumption {{0, 0}};
-
-        for (int i = 1; i <= max_number - min_number; i++) { fuel_consumption[i] = fuel_consumption[i-1] + i; }
-
-        // Actual simulation
-        auto [best_consumption, best_target] = find_best_consumption(distribution, fuel_consumption);
-
-        // Updates the results
-        result_fuel_2 = best_consumption;
-        result_target_2 = best_target;
+        if (CLOSED_FORM) {
+            auto [best_consumption, best_target] = find_best_triangular_consumption(values);
+            result_fuel_2 = to_string(best_consumption);
+            result_target_2 = best_target;
+        } else {
+            auto [best_consumption, best_target] = AlignmentSolver(histogram).find_best_consumption(triangular_model());
+            result_fuel_2 = to_string(best_consumption);
+            result_target_2 = best_target;
+        }
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
     printf("   The best horizontal position that the crabs can align is %d.\n", result_target_2);
-    printf("   The total consumption is %d of fuel.\n", result_fuel_2);
+    printf("   The total consumption is %s of fuel.\n", result_fuel_2.c_str());
+
+
+
+    // Custom fuel model (only if requested)
+    if (!CUSTOM_MODEL.empty()) {
+        std::string result_fuel_3;
+        int result_target_3;
+
+        float part_3_elapsed_time = time_block( [&](){
+            auto [best_consumption, best_target] = AlignmentSolver(histogram).find_best_consumption(parse_fuel_model(CUSTOM_MODEL));
+            result_fuel_3 = to_string(best_consumption);
+            result_target_3 = best_target;
+        });
+
+        // Custom fuel model visualization
+        printf("\n> Custom < (%f seconds)\n", part_3_elapsed_time);
+        printf("   With the %s fuel model, the best horizontal position that the crabs can align is %d.\n", CUSTOM_MODEL.c_str(), result_target_3);
+        printf("   The total consumption is %s of fuel.\n", result_fuel_3.c_str());
+    }
 
     return 0;
 }
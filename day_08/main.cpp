@@ -4,137 +4,201 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
-#include <unordered_map>
+#include <array>
+#include <bit>
+#include <initializer_list>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "../common/utils.hpp"
 
 
-class Entry
-{
-private:
-    std::vector<std::string> _signal_patterns;
-    std::vector<std::string> _output_digits;
+// Masks of an entry: the 10 signal patterns followed by the 4 output digits
+// > Every mask has 7 bits, where bit i is segment 'a' + i
+using EntryMasks = std::array<uint8_t, 14>;
+
+// Function that reads the masks of a raw entry
+using EntryParser = EntryMasks (*)(const std::string&);
+
+// Longest entry handled by the SIMD parser (longer ones go to the scalar parser)
+#define MAX_SIMD_ENTRY_LENGTH 128
+
+//
+// Reads the masks of a raw entry, one character at a time
+// > Any character that is not a segment ends a pattern, and the '|' separates the signal patterns from the output digits
+//
+EntryMasks parse_entry_scalar(const std::string& raw_entry) {
+    EntryMasks masks = {};
+    int patterns = 0, digits = 0;
+    bool in_output = false;
+    uint8_t mask = 0;
+
+    auto store = [&]() {
+        if (!mask) return;
+        if (in_output) { if (digits < 4) masks[10 + digits] = mask; digits++; }
+        else { if (patterns < 10) masks[patterns] = mask; patterns++; }
+        mask = 0;
+    };
+
+    for (const char & c : raw_entry) {
+        if (c >= 'a' && c <= 'g') { mask |= 1 << (c - 'a'); continue; }
+        store();
+        if (c == '|') { in_output = true; }
+    }
+    store();
 
-    std::unordered_map<std::string, std::string> _pattern2num;
-    std::unordered_map<std::string, std::string> _num2pattern;
+    if (patterns != 10 || digits != 4) throw std::invalid_argument("Invalid entry: " + raw_entry);
 
-public:
-    Entry() = delete;
-    Entry(const std::string& raw_entry) {
-        std::vector<std::string> parts = string_split(raw_entry, " | ");
-        
-        // Split the signal patterns from the output digits
-        _signal_patterns = string_split(parts[0], " ");
-        _output_digits = string_split(parts[1], " ");
-
-        // Sorts every signal pattern
-        for (auto & signal : _signal_patterns) {
-            std::sort(signal.begin(), signal.end());
-        }
+    return masks;
+}
 
-        // Sorts every output digit
-        for (auto & digit : _output_digits) {
-            std::sort(digit.begin(), digit.end());
+#if defined(__SSE2__)
+//
+// Reads the masks of a raw entry, 16 characters at a time
+// > Every block is classified with byte compares, giving the segment bit of each character and bitmasks of letters and '|'
+// > Patterns start where a letter follows a non letter, and their length is the run of letters from there
+// > The mask of a pattern is the OR of its segment bits, folded from a single 8 bytes load
+//
+EntryMasks parse_entry_simd(const std::string& raw_entry) {
+    if (raw_entry.size() > MAX_SIMD_ENTRY_LENGTH) return parse_entry_scalar(raw_entry);
+
+    // Zero padded copy, so all block loads stay inside the buffer
+    // > Only the last block needs the padding, since all others are overwritten by the copy
+    // > The segment bits have an extra block, for the 8 bytes loads of the patterns at the very end
+    const std::size_t n_blocks = (raw_entry.size() + 15) / 16;
+
+    alignas(16) std::array<char, MAX_SIMD_ENTRY_LENGTH> buffer;
+    alignas(16) std::array<uint8_t, MAX_SIMD_ENTRY_LENGTH + 16> segment_bits;
+    if (n_blocks) { _mm_store_si128((__m128i*)(buffer.data() + 16 * (n_blocks - 1)), _mm_setzero_si128()); }
+    _mm_store_si128((__m128i*)(segment_bits.data() + 16 * n_blocks), _mm_setzero_si128());
+    std::memcpy(buffer.data(), raw_entry.data(), raw_entry.size());
+
+    unsigned __int128 letters = 0, pipes = 0;
+
+    for (std::size_t block = 0; block < n_blocks; block++) {
+        const __m128i chars = _mm_load_si128((const __m128i*)(buffer.data() + 16 * block));
+
+        // Segment bit of every character (0 if it is not a segment)
+        __m128i bits = _mm_setzero_si128();
+        for (int segment = 0; segment < 7; segment++) {
+            const __m128i is_segment = _mm_cmpeq_epi8(chars, _mm_set1_epi8('a' + segment));
+            bits = _mm_or_si128(bits, _mm_and_si128(is_segment, _mm_set1_epi8(1 << segment)));
         }
+        _mm_store_si128((__m128i*)(segment_bits.data() + 16 * block), bits);
 
-        decipher();
-        }
+        const uint32_t letter_mask = _mm_movemask_epi8(_mm_cmpgt_epi8(bits, _mm_setzero_si128()));
+        const uint32_t pipe_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('|')));
 
-    void decipher() {
-        // QoL function to check if all segments of a signal are contained in other
-        auto contains_all = [](const std::string& seg1, const std::string& seg2){
-            bool all_found = true;
-            for (auto c : seg1) {
-                if (seg2.find(c) == seg2.npos) {
-                    all_found = false;
-                    break;
-                }
-            }
-            return all_found;
-        };
+        letters |= (unsigned __int128)letter_mask << (16 * block);
+        pipes |= (unsigned __int128)pipe_mask << (16 * block);
+    }
 
-        // Lets start by mapping the signals by its size
-        std::unordered_map<int, std::vector<std::string>> segments_by_size;
-        for (auto signal : _signal_patterns) {
-            segments_by_size[signal.size()].push_back(signal);
-        }
+    // Position of the first '|' (past the end if there is none)
+    const uint64_t low_pipes = (uint64_t)pipes, high_pipes = (uint64_t)(pipes >> 64);
+    const int pipe = low_pipes ? std::countr_zero(low_pipes) : high_pipes ? 64 + std::countr_zero(high_pipes) : MAX_SIMD_ENTRY_LENGTH;
 
-        // We already know 1, 4, 7, and 8
-        _pattern2num[segments_by_size[2][0]] = "1"; _num2pattern["1"] = segments_by_size[2][0];
-        _pattern2num[segments_by_size[3][0]] = "7"; _num2pattern["7"] = segments_by_size[3][0];
-        _pattern2num[segments_by_size[4][0]] = "4"; _num2pattern["4"] = segments_by_size[4][0];
-        _pattern2num[segments_by_size[7][0]] = "8"; _num2pattern["8"] = segments_by_size[7][0];
+    EntryMasks masks = {};
+    int patterns = 0, digits = 0;
 
-        // Lets now find 6
-        for (auto seg = segments_by_size[6].begin(); seg != segments_by_size[6].end(); seg++) {
-            if (!contains_all(segments_by_size[2][0], *seg)) {
-                // Adds the new discovery into the pattern dictionaries
-                _pattern2num[*seg] = "6";
-                _num2pattern["6"] = *seg;
+    unsigned __int128 starts = letters & ~(letters << 1);
+    while (starts) {
+        const uint64_t low_starts = (uint64_t)starts;
+        const int start = low_starts ? std::countr_zero(low_starts) : 64 + std::countr_zero((uint64_t)(starts >> 64));
+        starts &= starts - 1;
 
-                // Removes the element (needed for next steps)
-                segments_by_size[6].erase(seg);
+        // Patterns longer than 7 letters repeat segments, which only the scalar parser handles
+        const int length = std::countr_one((uint64_t)(letters >> start));
+        if (length > 7) return parse_entry_scalar(raw_entry);
 
-                break;
-            }
-        }
-        
-        // Lets now find 3
-        for (auto seg = segments_by_size[5].begin(); seg != segments_by_size[5].end(); seg++) {
-            if (contains_all(segments_by_size[2][0], *seg)) {
-                // Adds the new discovery into the pattern dictionaries
-                _pattern2num[*seg] = "3";
-                _num2pattern["3"] = *seg;
-
-                // Removes the element (needed for next steps)
-                segments_by_size[5].erase(seg);
-
-                break;
-            }
-        }
+        uint64_t word;
+        std::memcpy(&word, segment_bits.data() + start, sizeof(word));
+        word &= (1ull << (8 * length)) - 1;
+        word |= word >> 32;
+        word |= word >> 16;
+        word |= word >> 8;
 
-        // Lets now find 2 and 5
-        // > For this step, we will have start by finding the C segment character
-        // > Then, this C segment will be used to distinguish between the 2 and 5 values
-        std::string c_segment;
-        for (auto c1 : _num2pattern["8"]) {
-            if (_num2pattern["6"].find(c1) == _num2pattern["6"].npos) {
-                c_segment = c1;
-                break;
-            }
+        if (start > pipe) { if (digits < 4) masks[10 + digits] = (uint8_t)word; digits++; }
+        else { if (patterns < 10) masks[patterns] = (uint8_t)word; patterns++; }
+    }
+
+    if (patterns != 10 || digits != 4) throw std::invalid_argument("Invalid entry: " + raw_entry);
+
+    return masks;
+}
+#else
+// Without SSE2, the scalar parser does the job
+EntryMasks parse_entry_simd(const std::string& raw_entry) { return parse_entry_scalar(raw_entry); }
+#endif
+
+//
+// A display entry, with its patterns and output digits stored as 7 bits masks
+// > The decoding is a lookup in a table indexed by the masks, so no strings are kept after parsing
+//
+class Entry
+{
+private:
+    std::array<uint8_t, 10> _signal_patterns;
+    std::array<uint8_t, 4> _output_digits;
+
+    // Digit of each pattern mask (-1 if the mask is not one of the patterns)
+    std::array<int8_t, 128> _pattern2num;
+
+public:
+    Entry() = delete;
+    Entry(const EntryMasks& masks) {
+        std::copy_n(masks.begin(), 10, _signal_patterns.begin());
+        std::copy_n(masks.begin() + 10, 4, _output_digits.begin());
+
+        decipher();
+    }
+
+    void decipher() {
+        // We already know 1 and 4 (the only patterns with 2 and 4 segments)
+        uint8_t one = 0, four = 0;
+        for (const auto & pattern : _signal_patterns) {
+            if (std::popcount(pattern) == 2) { one = pattern; }
+            if (std::popcount(pattern) == 4) { four = pattern; }
         }
-        
-        if (segments_by_size[5][0].find(c_segment) == segments_by_size[5][0].npos) {
-            // Adds the new discovery into the pattern dictionaries
-            _pattern2num[segments_by_size[5][0]] = "5"; _num2pattern["5"] = segments_by_size[5][0];
-            _pattern2num[segments_by_size[5][1]] = "2"; _num2pattern["2"] = segments_by_size[5][1];
-        } else {
-            // Adds the new discovery into the pattern dictionaries
-            _pattern2num[segments_by_size[5][0]] = "2"; _num2pattern["2"] = segments_by_size[5][0];
-            _pattern2num[segments_by_size[5][1]] = "5"; _num2pattern["5"] = segments_by_size[5][1];
+
+        // Every digit has a unique signature: its amount of segments, and how many of them it shares with 1 and 4
+        _pattern2num.fill(-1);
+        for (const auto & pattern : _signal_patterns) {
+            _pattern2num[pattern] = digit_from_signature(std::popcount(pattern), std::popcount<uint8_t>(pattern & one), std::popcount<uint8_t>(pattern & four));
         }
+    }
 
-        // Lets now find 0 and 9
-        if (contains_all(_num2pattern["5"], segments_by_size[6][0])) {
-            // Adds the new discovery into the pattern dictionaries
-            _pattern2num[segments_by_size[6][0]] = "9"; _num2pattern["9"] = segments_by_size[6][0];
-            _pattern2num[segments_by_size[6][1]] = "0"; _num2pattern["0"] = segments_by_size[6][1];
-        } else {
-            // Adds the new discovery into the pattern dictionaries
-            _pattern2num[segments_by_size[6][0]] = "0"; _num2pattern["0"] = segments_by_size[6][0];
-            _pattern2num[segments_by_size[6][1]] = "9"; _num2pattern["9"] = segments_by_size[6][1];
+    //
+    // Finds a digit from its signature
+    // > Digits with 2, 3, 4 and 7 segments are unique by their amount of segments
+    // > Digits with 5 and 6 segments are told apart by the segments they share with 1 and 4
+    //
+    static constexpr int digit_from_signature(int segments, int common_with_1, int common_with_4) {
+        switch (segments) {
+            case 2: return 1;
+            case 3: return 7;
+            case 4: return 4;
+            case 7: return 8;
+            case 5: return (common_with_1 == 2) ? 3 : (common_with_4 == 3) ? 5 : 2;
+            case 6: return (common_with_1 == 1) ? 6 : (common_with_4 == 4) ? 9 : 0;
+            default: return -1;
         }
     }
 
     int count_output_instances_of(int num) const {
         int total = 0;
         for (const auto & digit : _output_digits) {
-            if (_pattern2num.at(digit) == std::to_string(num)) { total++; }
+            if (_pattern2num[digit] == num) { total++; }
         }
         return total;
     }
 
-    int count_output_instances_of(const std::vector<int>& nums) const {
+    int count_output_instances_of(std::initializer_list<int> nums) const {
         int total = 0;
         for (const auto & num : nums) {
             total += count_output_instances_of(num);
@@ -143,30 +207,91 @@ public:
     }
 
     int get_output() const {
-        std::string str_number;
+        int number = 0;
 
-        for (const auto & str : _output_digits) {
-            str_number += _pattern2num.at(str);
+        for (const auto & digit : _output_digits) {
+            number = number * 10 + _pattern2num[digit];
         }
 
-        return std::stoi(str_number);
+        return number;
     }
 };
 
 
-std::vector<Entry> parse_inputs(int argc, char* argv[]) {
+//
+// Totals of a batch of entries, gathered while decoding them
+//
+struct DecodeSummary {
+    uint64_t unique_digits = 0; // Output digits that are a 1, 4, 7 or 8
+    uint64_t output_sum = 0;    // Sum of all the output values
+};
+
+// Minimum amount of entries that justify an extra thread
+#define ENTRIES_PER_THREAD 16384
+
+//
+// Decodes a batch of raw entries, splitting them in contiguous chunks among the threads
+// > Every entry is parsed and deciphered exactly once, and both totals are taken from that single decode
+// > Each thread keeps its own summary, so there is no sharing until the final reduction
+//
+DecodeSummary decode_entries(const std::vector<std::string>& raw_entries, EntryParser parse_entry) {
+    const std::size_t n_threads = std::clamp<std::size_t>(raw_entries.size() / ENTRIES_PER_THREAD, 1, std::max(1u, std::thread::hardware_concurrency()));
+    const std::size_t chunk = (raw_entries.size() + n_threads - 1) / n_threads;
+
+    std::vector<DecodeSummary> summaries(n_threads);
+    std::vector<std::exception_ptr> errors(n_threads);
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < n_threads; w++) {
+        workers.emplace_back([&raw_entries, &summaries, &errors, parse_entry, w, chunk](){
+            const std::size_t begin = std::min(raw_entries.size(), w * chunk);
+            const std::size_t end = std::min(raw_entries.size(), begin + chunk);
+
+            DecodeSummary summary;
+            try {
+                for (std::size_t i = begin; i < end; i++) {
+                    if (raw_entries[i].empty()) continue;
+
+                    const Entry entry(parse_entry(raw_entries[i]));
+                    summary.unique_digits += entry.count_output_instances_of({1, 4, 7, 8});
+                    summary.output_sum += entry.get_output();
+                }
+            }
+            catch (...) { errors[w] = std::current_exception(); }
+
+            summaries[w] = summary;
+        });
+    }
+    for (auto & worker : workers) { worker.join(); }
+
+    // Invalid entries are reported back in the calling thread
+    for (const auto & error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    DecodeSummary total;
+    for (const auto & summary : summaries) {
+        total.unique_digits += summary.unique_digits;
+        total.output_sum += summary.output_sum;
+    }
+
+    return total;
+}
+
+std::vector<std::string> parse_inputs(int argc, char* argv[]) {
     // Makes sure a input file is specified
     if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
 
     // Actual outputs
-    std::vector<Entry> output;
+    // > Entries are kept raw, their parsing is part of the (parallel) decoding
+    std::vector<std::string> output;
 
     // Open input file
     std::ifstream input_file(std::string(argv[1]), std::ios::in);
 
     std::string line;
     while(std::getline(input_file, line)) {
-        output.push_back(Entry(line));
+        output.push_back(line);
     }
 
     return output;
@@ -174,41 +299,89 @@ std::vector<Entry> parse_inputs(int argc, char* argv[]) {
 
 
 
+//
+// Measures how many entries per second a parser is able to read (single threaded, parsing only)
+//
+double benchmark_parser(const std::vector<std::string>& raw_entries, EntryParser parse_entry) {
+    std::size_t parsed = 0;
+    uint8_t checksum = 0;
+
+    float elapsed_time = time_block( [&](){
+        for (const auto & raw_entry : raw_entries) {
+            if (raw_entry.empty()) continue;
+
+            const EntryMasks masks = parse_entry(raw_entry);
+            for (const auto & mask : masks) { checksum ^= mask; }
+            parsed++;
+        }
+    });
+
+    // Keeps the parsing from being optimized away (the checksum has to be stored, but nothing is printed)
+    volatile uint8_t sink = checksum;
+    (void)sink;
+
+    return parsed / std::max<double>(elapsed_time, 1e-9);
+}
+
 int main(int argc, char* argv[]) {
     // Common
-    const auto entries = parse_inputs(argc, argv);
+    const auto raw_entries = parse_inputs(argc, argv);
+
+    // Options
+    // > "--scalar" parses the entries one character at a time, instead of using the SIMD parser
+    // > "--benchmark" also measures the throughput of both parsers
+    EntryParser PARSER = parse_entry_simd;
+    bool BENCHMARK = false;
+    for (int i = 2; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--scalar") { PARSER = parse_entry_scalar; }
+        else if (option == "--benchmark") { BENCHMARK = true; }
+        else { throw std::invalid_argument("Unknown option " + option + "."); }
+    }
+
+    // Both parts come out of the same decoding pass
+    DecodeSummary summary;
+
+    float decode_elapsed_time = time_block( [&](){
+        summary = decode_entries(raw_entries, PARSER);
+    });
 
     // Part One algorithms
-    int result_1 = 0;
+    uint64_t result_1 = 0;
 
-    float part_1_elapsed_time = time_block( [&](){
-        for (const auto & entry : entries) {
-            result_1 += entry.count_output_instances_of({1, 4, 7, 8});
-        }
+    float part_1_elapsed_time = decode_elapsed_time + time_block( [&](){
+        result_1 = summary.unique_digits;
     });
     
     // Part One visualization
     printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
-    printf("   There are a total of %d intances of the digits 1, 4, 7, or 8.\n", result_1);
+    printf("   There are a total of %llu intances of the digits 1, 4, 7, or 8.\n", (unsigned long long)result_1);
 
 
 
     // Part Two algorithms
-    int result_2 = 0;
-
-    float part_2_elapsed_time = time_block( [&](){
-        for (auto entry : entries) {\
-            // The current implementation has already this step done it its constructor.
-            // > However, this part was the one that required the decipher of the signals
-            // > We will re-do the decipher step for the sake of timing the part
-            entry.decipher();
-            result_2 += entry.get_output();
-        }
+    uint64_t result_2 = 0;
+
+    float part_2_elapsed_time = decode_elapsed_time + time_block( [&](){
+        result_2 = summary.output_sum;
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
-    printf("   The last board to win have a final score of %d.\n", result_2);  
+    printf("   The last board to win have a final score of %llu.\n", (unsigned long long)result_2);  
+
+
+
+    // Parsers benchmark (only if requested)
+    if (BENCHMARK) {
+        const double scalar_throughput = benchmark_parser(raw_entries, parse_entry_scalar);
+        const double simd_throughput = benchmark_parser(raw_entries, parse_entry_simd);
+
+        // Benchmark visualization
+        printf("\n> Benchmark <\n");
+        printf("   The scalar parser reads %.0f entries per second.\n", scalar_throughput);
+        printf("   The SIMD parser reads %.0f entries per second (%.2fx).\n", simd_throughput, simd_throughput / scalar_throughput);
+    }
 
     return 0;
 }
@@ -2,126 +2,327 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <queue>
+#include <cstdint>
+#include <array>
+#include <bit>
+#include <functional>
+#include <thread>
 #include <algorithm>
 
-#include "../common/utils.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
-struct Point {
-    int x = 0;
-    int y = 0;
-    int height = 0;
+#include "../common/utils.hpp"
 
-    bool operator<(Point const &p) const {
-        return x < p.x || (x == p.x && y < p.y);
-    }
+// Height of the padding around the map (higher than any cell, so it never hides a low point)
+#define PADDING_HEIGHT 10
 
-    bool operator==(Point const &p) const {
-        return (x==p.x) && (y==p.y);
-    }
+//
+// Low points of a heightmap, found in a single sweep
+//
+struct LowPoints {
+    std::vector<uint64_t> bitmask; // One bit per cell, set for the low points
+    uint64_t risk_level = 0;       // Sum of the heights of all low points plus one
 };
 
+//
+// Heightmap stored as a flat grid of 1 byte heights (row after row)
+// > Cells are referred by their index in the grid, so there is no need for a point structure
+// > A padded copy of the grid is also kept, so the low points kernel needs no bounds checks
+//
 class Heightmap
 {
 private:
-    std::vector<std::vector<Point>> _data;
+    std::vector<uint8_t> _heights;
+    int _width = 0;
+    int _height = 0;
+
+    // Padded grid: one row of padding above and below, one column on the left, and the remaining of the row on the right
+    // > Rows are long enough for a full 32 bytes load of the neighbours of their last cell
+    std::vector<uint8_t> _padded;
+    std::size_t _stride = 0;
+
+private:
+    // Marks the low points of a padded row, in blocks of 32 cells
+    // > Every block is compared with its shifted neighbours, and the 4 comparisons are joined in a single movemask
+    // > The risk level is the sum of the masked heights, added up with sum of absolute differences
+    static void _scan_row(const uint8_t* up, const uint8_t* row, const uint8_t* down, int width, uint64_t* bits, std::size_t first_bit, uint64_t& risk_level) {
+#if defined(__AVX2__)
+        const __m256i ones = _mm256_set1_epi8(1);
+        __m256i risk = _mm256_setzero_si256();
+
+        for (int x = 1; x <= width; x += 32) {
+            const __m256i center = _mm256_loadu_si256((const __m256i*)(row + x));
+            const __m256i lower_than_left = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(row + x - 1)), center);
+            const __m256i lower_than_right = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(row + x + 1)), center);
+            const __m256i lower_than_up = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(up + x)), center);
+            const __m256i lower_than_down = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)(down + x)), center);
+            const __m256i low = _mm256_and_si256(_mm256_and_si256(lower_than_left, lower_than_right), _mm256_and_si256(lower_than_up, lower_than_down));
+
+            // Padding is never a low point, so lanes past the width are always 0
+            const uint64_t low_mask = (uint32_t)_mm256_movemask_epi8(low);
+            const std::size_t bit = first_bit + x - 1;
+            bits[bit / 64] |= low_mask << (bit % 64);
+            if (bit % 64 > 32) { bits[bit / 64 + 1] |= low_mask >> (64 - bit % 64); }
+
+            risk = _mm256_add_epi64(risk, _mm256_sad_epu8(_mm256_and_si256(low, _mm256_add_epi8(center, ones)), _mm256_setzero_si256()));
+        }
+
+        alignas(32) std::array<uint64_t, 4> partial_risks;
+        _mm256_store_si256((__m256i*)partial_risks.data(), risk);
+        risk_level += partial_risks[0] + partial_risks[1] + partial_risks[2] + partial_risks[3];
+#else
+        // Without AVX2, the same comparisons are done without branches, so the compiler is able to vectorize them
+        for (int start = 1; start <= width; start += 64) {
+            const int end = std::min(width + 1, start + 64);
+
+            std::array<uint8_t, 64> low;
+            uint64_t risk = 0;
+            for (int x = start; x < end; x++) {
+                low[x - start] = (row[x] < row[x - 1]) & (row[x] < row[x + 1]) & (row[x] < up[x]) & (row[x] < down[x]);
+                risk += low[x - start] * (row[x] + 1);
+            }
+            risk_level += risk;
+
+            uint64_t low_mask = 0;
+            for (int i = 0; i < end - start; i++) { low_mask |= (uint64_t)low[i] << i; }
+
+            const std::size_t bit = first_bit + start - 1;
+            bits[bit / 64] |= low_mask << (bit % 64);
+            if (bit % 64) { bits[bit / 64 + 1] |= low_mask >> (64 - bit % 64); }
+        }
+#endif
+    }
 
 public:
     Heightmap() = delete;
-    Heightmap(const std::vector<std::vector<int>>& data) {
-        // Wraps the data from a matrix of ints to a matrix of Points
-        for (int y = 0; y < data.size(); y++) {
-            std::vector<Point> line;
-            for (int x = 0; x < data[y].size(); x++) {
-                line.push_back( {x, y, data[y][x]} );
-            }
-            _data.push_back(line);
+    Heightmap(std::vector<uint8_t> heights, int width, int height) : _heights(std::move(heights)), _width(width), _height(height) {
+        _stride = (width + 33 + 31) / 32 * 32;
+        _padded.assign(_stride * (height + 2), PADDING_HEIGHT);
+        for (int y = 0; y < height; y++) {
+            std::copy_n(_heights.begin() + (std::size_t)y * width, width, _padded.begin() + (y + 1) * _stride + 1);
         }
     }
 
-    int y_range() const { return _data.size(); }
-    int x_range() const { return _data[0].size(); }
+    int x_range() const { return _width; }
+    int y_range() const { return _height; }
 
-    std::vector<Point> find_low_points() const {
-        // List of low points that will be returned
-        std::vector<Point> low_points;
+    int height_of(std::size_t cell) const { return _heights[cell]; }
+    const std::vector<uint8_t>& get_heights() const { return _heights; }
 
-        // Goes through all the points in the map
-        for (int y = 0; y < y_range(); y++) {
-            for (int x = 0; x < x_range(); x++) {
-                // Current point being analysed
-                // > It is considered a low point if its height is inferior than all its neighbours
-                const Point& point = _data[y][x];
+    //
+    // Finds all the low points (and their risk level) in a single sweep of the padded grid
+    // > A low point is lower than all its neighbours, which in the padded grid are always there
+    //
+    LowPoints scan_low_points() const {
+        LowPoints output;
+
+        // One extra word, for the blocks that go past the last cell
+        output.bitmask.assign(((std::size_t)_width * _height + 63) / 64 + 1, 0);
+
+        for (int y = 0; y < _height; y++) {
+            const uint8_t* row = _padded.data() + (y + 1) * _stride;
+            _scan_row(row - _stride, row, row + _stride, _width, output.bitmask.data(), (std::size_t)y * _width, output.risk_level);
+        }
 
-                // Top and Left checks
-                if (y > 0 && point.height >= _data[y-1][x].height) continue;
-                if (x > 0 && point.height >= _data[y][x-1].height) continue;
+        output.bitmask.pop_back();
+        return output;
+    }
 
-                // Bottom and Right checks
-                if (y < y_range()-1 && point.height >= _data[y+1][x].height) continue;
-                if (x < x_range()-1 && point.height >= _data[y][x+1].height) continue;
+    std::vector<std::size_t> find_low_points() const {
+        // List of low points that will be returned
+        std::vector<std::size_t> low_points;
 
-                // It's a low point!
-                low_points.push_back( point );
+        // Goes through the set bits of the low points bitmask
+        const LowPoints scan = scan_low_points();
+        for (std::size_t word = 0; word < scan.bitmask.size(); word++) {
+            for (uint64_t bits = scan.bitmask[word]; bits; bits &= bits - 1) {
+                low_points.push_back(word * 64 + std::countr_zero(bits));
             }
         }
 
         return low_points;
     }
-    
-    std::vector<std::vector<Point>> find_basins() const {
-        // There are as many basins as low points
-        std::vector<Point> low_points = find_low_points();
 
-        // List of basins that will be returned
-        std::vector<std::vector<Point>> basins; basins.reserve(low_points.size());
+    //
+    // Finds the size of the basin of every low point
+    // > Every basin is flood filled from its low point, always climbing (and never into a height of 9)
+    // > A single visited bitmap is shared by all the basins, so every cell is pushed at most once in the whole map
+    // > Since every cell belongs to a single basin, sharing the bitmap does not change any size
+    //
+    std::vector<uint64_t> find_basin_sizes() const {
+        std::vector<std::size_t> low_points = find_low_points();
+
+        // Sizes list that will be returned
+        std::vector<uint64_t> sizes; sizes.reserve(low_points.size());
+
+        std::vector<uint64_t> visited((_heights.size() + 63) / 64, 0);
+        auto visit = [&visited](std::size_t cell) {
+            uint64_t& word = visited[cell / 64];
+            const uint64_t bit = 1ull << (cell % 64);
+            if (word & bit) return false;
+            word |= bit;
+            return true;
+        };
+
+        // Explicit stack, reused by all the basins
+        std::vector<std::size_t> stack;
 
         for (const auto & low_point : low_points) {
+            uint64_t size = 0;
 
-            // Points list for the current basin
-            std::vector<Point> basin;
+            if (_heights[low_point] != 9 && visit(low_point)) { stack.push_back(low_point); }
 
-            // Find all the basin points (starting in the low point)
-            std::queue<Point> next_to_analyse; next_to_analyse.push(low_point);
-            while (!next_to_analyse.empty()) {
+            while (!stack.empty()) {
                 // Current point being analysed
-                Point point = next_to_analyse.front(); next_to_analyse.pop();
-
-                // Do not proceed if the current point is the maximum height
-                if (point.height == 9) { continue; }
-
-                // Do not proceed if this point is already part of the basin
-                if (std::find_if(basin.begin(), basin.end(), [point](Point const& other){ return point == other; }) != basin.end()) { continue; }
+                const std::size_t cell = stack.back(); stack.pop_back();
+                const uint8_t height = _heights[cell];
+                const int x = cell % _width;
+                const int y = cell / _width;
 
                 // It is a point of the basin!
-                basin.push_back(point);
-
-                // Top
-                if (point.y > 0 && point.height <= _data[point.y-1][point.x].height) {
-                    next_to_analyse.push({point.x, point.y-1, _data[point.y-1][point.x].height});
-                }
-
-                // Bottom
-                if (point.y < y_range() - 1 && point.height <= _data[point.y+1][point.x].height) {
-                    next_to_analyse.push({point.x, point.y+1, _data[point.y+1][point.x].height});
-                }
-
-                // Right
-                if (point.x > 0 && point.height <= _data[point.y][point.x-1].height) {
-                    next_to_analyse.push({point.x-1, point.y, _data[point.y][point.x-1].height});
-                }
-
-                // Left
-                if (point.x < x_range() - 1 && point.height <= _data[point.y][point.x+1].height) {
-                    next_to_analyse.push({point.x+1, point.y, _data[point.y][point.x+1].height});
-                }
+                size++;
+
+                // Neighbours are part of the basin if they are not lower, and not the maximum height
+                auto try_push = [&](std::size_t neighbour) {
+                    const uint8_t neighbour_height = _heights[neighbour];
+                    if (neighbour_height != 9 && height <= neighbour_height && visit(neighbour)) { stack.push_back(neighbour); }
+                };
+
+                if (y > 0) try_push(cell - _width);
+                if (y < _height - 1) try_push(cell + _width);
+                if (x > 0) try_push(cell - 1);
+                if (x < _width - 1) try_push(cell + 1);
             }
 
             // Adds the found basin into the list of basins
-            basins.push_back(basin);
+            sizes.push_back(size);
+        }
+
+        return sizes;
+    }
+};
+
+
+
+//
+// Finds the basins as the connected components of the map, with the heights of 9 acting as walls
+// > The map is split in bands of rows, one per thread, and each band is labeled with its own union-find
+// > The bands are then merged through the borders between them, which only takes a row per band
+// > Every root keeps the size of its component (as a negative parent), so sizes come out of the merges directly
+//
+class BasinLabeler
+{
+private:
+    // Minimum amount of rows that justify an extra thread
+    static constexpr int ROWS_PER_THREAD = 64;
+
+    const Heightmap& _heightmap;
+
+    // Parent of every cell (roots hold minus the size of their component instead)
+    std::vector<int32_t> _parent;
+
+    // First row of every band (plus the end of the map)
+    std::vector<int> _bands;
+
+private:
+    bool _is_wall(std::size_t cell) const { return _heightmap.get_heights()[cell] == 9; }
+
+    int32_t _find(int32_t cell) {
+        // Path halving: every visited cell skips to its grandparent
+        while (_parent[cell] >= 0) {
+            if (_parent[_parent[cell]] >= 0) { _parent[cell] = _parent[_parent[cell]]; }
+            cell = _parent[cell];
         }
+        return cell;
+    }
+
+    void _union(int32_t a, int32_t b) {
+        a = _find(a);
+        b = _find(b);
+        if (a == b) return;
+
+        // The smaller component hangs from the larger one (sizes are negative)
+        if (_parent[a] > _parent[b]) std::swap(a, b);
+        _parent[a] += _parent[b];
+        _parent[b] = a;
+    }
+
+    void _label_band(int first_row, int end_row) {
+        const int width = _heightmap.x_range();
+
+        // Only joins with the top and left neighbours, which were already labeled
+        // > The first row of the band is not joined with the row above (that is the merge between bands)
+        for (int y = first_row; y < end_row; y++) {
+            for (int x = 0; x < width; x++) {
+                const int32_t cell = y * width + x;
+                if (_is_wall(cell)) continue;
+
+                _parent[cell] = -1;
+                if (x > 0 && !_is_wall(cell - 1)) { _union(cell, cell - 1); }
+                if (y > first_row && !_is_wall(cell - width)) { _union(cell, cell - width); }
+            }
+        }
+    }
+
+    void _collect_band(int first_row, int end_row, std::vector<uint64_t>& sizes) const {
+        const int width = _heightmap.x_range();
+
+        for (int32_t cell = first_row * width; cell < end_row * width; cell++) {
+            if (!_is_wall(cell) && _parent[cell] < 0) { sizes.push_back(-_parent[cell]); }
+        }
+    }
+
+public:
+    BasinLabeler() = delete;
+    BasinLabeler(const Heightmap& heightmap, std::size_t n_threads) : _heightmap(heightmap) {
+        const int width = heightmap.x_range();
+        const int height = heightmap.y_range();
+
+        if ((uint64_t)width * height > INT32_MAX) throw std::invalid_argument("Heightmaps larger than 2^31 cells are not supported.");
+
+        _parent.assign((std::size_t)width * height, -1);
+
+        // Splits the rows in bands (never more bands than what the rows justify)
+        n_threads = std::clamp<std::size_t>(std::min<std::size_t>(n_threads, height / ROWS_PER_THREAD), 1, std::max(height, 1));
+        for (std::size_t band = 0; band <= n_threads; band++) { _bands.push_back(height * band / n_threads); }
+
+        // Labels every band in its own thread
+        // > A band only ever touches its own cells, so no synchronization is needed
+        std::vector<std::thread> workers;
+        for (std::size_t band = 0; band < n_threads; band++) {
+            workers.emplace_back([this, band](){ _label_band(_bands[band], _bands[band + 1]); });
+        }
+        for (auto & worker : workers) { worker.join(); }
+
+        // Merges the bands through their borders
+        for (std::size_t band = 1; band < n_threads; band++) {
+            const int32_t first_cell = _bands[band] * width;
+            for (int32_t cell = first_cell; cell < first_cell + width; cell++) {
+                if (!_is_wall(cell) && !_is_wall(cell - width)) { _union(cell, cell - width); }
+            }
+        }
+    }
+
+    // Amount of bands (and so of threads) actually used, which the size of the map may keep below the requested threads
+    std::size_t get_band_count() const { return _bands.size() - 1; }
+
+    std::vector<uint64_t> get_basin_sizes() const {
+        // Every band collects the sizes of the roots it holds
+        const std::size_t n_bands = _bands.size() - 1;
+        std::vector<std::vector<uint64_t>> band_sizes(n_bands);
+
+        std::vector<std::thread> workers;
+        for (std::size_t band = 0; band < n_bands; band++) {
+            workers.emplace_back([this, band, &band_sizes](){ _collect_band(_bands[band], _bands[band + 1], band_sizes[band]); });
+        }
+        for (auto & worker : workers) { worker.join(); }
+
+        std::vector<uint64_t> sizes;
+        for (const auto & band : band_sizes) { sizes.insert(sizes.end(), band.begin(), band.end()); }
 
-        return basins;
+        return sizes;
     }
 };
 
@@ -132,21 +333,27 @@ Heightmap parse_inputs(int argc, char* argv[]) {
     if (argc <= 1) throw std::invalid_argument("You have to specify an input text file.");
 
     // Actual outputs
-    std::vector<std::vector<int>> output;
+    std::vector<uint8_t> heights;
+    int width = 0, height = 0;
 
     // Open input file
     std::ifstream input_file(std::string(argv[1]), std::ios::in);
 
     std::string line;
     while (std::getline(input_file, line)) {
-        std::vector<int> line_numbers;
-        for (auto num : line ) {
-            line_numbers.push_back(num - '0');
+        if (line.empty()) continue;
+
+        // All the lines have the same width as the first one
+        if (height == 0) { width = line.size(); }
+        if (line.size() != width) throw std::invalid_argument("All the lines of the heightmap must have the same width.");
+
+        for (const auto & num : line) {
+            heights.push_back(num - '0');
         }
-        output.push_back(line_numbers);
+        height++;
     }
 
-    return Heightmap{output};
+    return Heightmap{std::move(heights), width, height};
 }
 
 
@@ -155,49 +362,79 @@ int main(int argc, char* argv[]) {
     // Common
     const auto heightmap = parse_inputs(argc, argv);
 
-    std::vector<Point> lowest_points;
+    // Options
+    // > "--flood-fill" finds the basins by flood filling them from the low points, instead of labeling the whole map
+    // > "--benchmark" also measures the labeling with an increasing amount of threads
+    bool FLOOD_FILL = false;
+    bool BENCHMARK = false;
+    for (int i = 2; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--flood-fill") { FLOOD_FILL = true; }
+        else if (option == "--benchmark") { BENCHMARK = true; }
+        else { throw std::invalid_argument("Unknown option " + option + "."); }
+    }
+
+    const std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
 
     // Part One algorithms
-    int result_1 = 0;
+    uint64_t result_1 = 0;
 
     float part_1_elapsed_time = time_block( [&](){
-        // Gets the low points from the heightmap
-        std::vector<Point> low_points = heightmap.find_low_points();
-
-        // Performs the calculations
-        for (const auto & point : low_points) {
-            result_1 += point.height + 1;
-        }
+        // The risk level comes out of the same sweep that finds the low points
+        result_1 = heightmap.scan_low_points().risk_level;
     });
     
     // Part One visualization
     printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
-    printf("   The sum of all low points is %d.\n", result_1);   
+    printf("   The sum of all low points is %llu.\n", (unsigned long long)result_1);   
 
 
 
     // Part Two algorithms
-    int result_2 = 1;
+    uint64_t result_2 = 1;
 
     float part_2_elapsed_time = time_block( [&](){
-        // Gets all the basins
-        std::vector<std::vector<Point>> basins = heightmap.find_basins();
-        
-        // Sorts the basins by its size (descending order)
-        std::sort(basins.begin(), basins.end(),
-            [](const std::vector<Point> &a, const std::vector<Point> &b){ return a.size() > b.size(); }
-        );
+        // Gets the size of all the basins
+        std::vector<uint64_t> sizes = FLOOD_FILL ? heightmap.find_basin_sizes() : BasinLabeler(heightmap, max_threads).get_basin_sizes();
 
         // Guarantees that at least 3 basins exist
-        if (basins.size() < 3) { throw std::runtime_error("Something went wrong... The algorithm could not find at least 3 basins."); }
+        if (sizes.size() < 3) { throw std::runtime_error("Something went wrong... The algorithm could not find at least 3 basins."); }
+
+        // Only the three largest basins need to be in order (descending order)
+        std::partial_sort(sizes.begin(), sizes.begin() + 3, sizes.end(), std::greater<uint64_t>());
 
         // Performs the calculations
-        for (int i = 0; i < 3; i++) { result_2 *= basins[i].size(); }
+        for (int i = 0; i < 3; i++) { result_2 *= sizes[i]; }
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
-    printf("   The size multiplication of the three largest basins is %d.\n", result_2);  
+    printf("   The size multiplication of the three largest basins is %llu.\n", (unsigned long long)result_2);  
+
+
+
+    // Labeling benchmark (only if requested)
+    if (BENCHMARK) {
+        printf("\n> Benchmark <\n");
+
+        // Doubles the threads up to the available ones (which are always measured)
+        // > Stops as soon as the map has no rows for more bands, since the extra threads would not be used
+        float single_thread_time = 0;
+        std::size_t previous_bands = 0;
+        for (std::size_t n_threads = 1; n_threads <= max_threads; n_threads = (n_threads == max_threads) ? n_threads + 1 : std::min(2 * n_threads, max_threads)) {
+            std::size_t n_basins = 0, n_bands = 0;
+            float elapsed_time = time_block( [&](){
+                const BasinLabeler labeler(heightmap, n_threads);
+                n_basins = labeler.get_basin_sizes().size();
+                n_bands = labeler.get_band_count();
+            });
+            if (n_bands == previous_bands) break;
+            if (n_bands == 1) { single_thread_time = elapsed_time; }
+            previous_bands = n_bands;
+
+            printf("   With %zu thread(s), %zu basins were labeled in %f seconds (%.2fx).\n", n_bands, n_basins, elapsed_time, single_thread_time / elapsed_time);
+        }
+    }
 
     return 0;
 }
@@ -2,9 +2,15 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
-#include <unordered_map>
+#include <array>
 #include <algorithm>
 #include <cstdint>
+#include <exception>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "../common/utils.hpp"
 
@@ -28,108 +34,420 @@ std::vector<std::string> parse_inputs(int argc, char* argv[]) {
     return lines;
 }
 
-std::unordered_map<char, char> CHUNK_PAIRS = { {'(', ')'}, {'[', ']'}, {'{', '}'}, {'<', '>'} };
+// Nesting of chunks that fits in the stack without any allocation (deeper lines spill into a growable buffer)
+#define INLINE_CHUNK_DEPTH 1024
+
+//
+// Classification of a character
+// > Chunk types are 0 for (), 1 for [], 2 for {} and 3 for <>
+//
+struct BracketClass {
+    int8_t chunk = -1;          // Chunk type (-1 if it is not a bracket)
+    bool is_open = false;
+    int corruption_points = 0;  // Points if it is the first illegal character of a line
+};
+
+constexpr std::array<BracketClass, 256> make_bracket_classes() {
+    constexpr std::array<char, 4> OPEN = { '(', '[', '{', '<' };
+    constexpr std::array<char, 4> CLOSE = { ')', ']', '}', '>' };
+    constexpr std::array<int, 4> CORRUPTION_POINTS = { 3, 57, 1197, 25137 };
+
+    std::array<BracketClass, 256> classes = {};
+    for (int8_t chunk = 0; chunk < 4; chunk++) {
+        classes[(uint8_t)OPEN[chunk]] = { chunk, true, 0 };
+        classes[(uint8_t)CLOSE[chunk]] = { chunk, false, CORRUPTION_POINTS[chunk] };
+    }
+    return classes;
+}
+
+// Lookup table with the class of every character
+constexpr std::array<BracketClass, 256> BRACKET_CLASSES = make_bracket_classes();
+
+static_assert(BRACKET_CLASSES['('].is_open && BRACKET_CLASSES[')'].chunk == 0 && BRACKET_CLASSES['>'].corruption_points == 25137);
+
+enum class LineStatus { Complete, Incomplete, Corrupted };
+
+struct LineScore {
+    LineStatus status = LineStatus::Complete;
+    uint64_t score = 0; // Corruption score if corrupted, completion score if incomplete
+};
+
+//
+// Scores a line in a single pass
+// > The open chunks are kept in a fixed capacity stack, and every character is classified with a single lookup
+// > If the fixed stack gets full, it is moved into a growable buffer (so there is no limit on the nesting)
+// > The line ends either at the first illegal character (corrupted), or with the open chunks left to complete
+// > Completion points of a chunk are just its type plus one
+//
+LineScore score_line(const std::string& line) {
+    std::array<int8_t, INLINE_CHUNK_DEPTH> inline_chunks;
+    std::vector<int8_t> spilled_chunks;
+
+    int8_t* open_chunks = inline_chunks.data();
+    std::size_t capacity = INLINE_CHUNK_DEPTH;
+    std::size_t depth = 0;
+
+    for (const char & c : line) {
+        const BracketClass& bracket = BRACKET_CLASSES[(uint8_t)c];
+
+        if (bracket.chunk < 0) throw std::invalid_argument("Invalid character in line: " + line);
+
+        // Opens a new chunk
+        if (bracket.is_open) {
+            if (depth == capacity) {
+                if (spilled_chunks.empty()) { spilled_chunks.assign(inline_chunks.begin(), inline_chunks.end()); }
+                spilled_chunks.resize(2 * capacity);
+                open_chunks = spilled_chunks.data();
+                capacity = spilled_chunks.size();
+            }
+            open_chunks[depth++] = bracket.chunk;
+            continue;
+        }
 
-bool is_open_char(const char & c) {
-    for (const auto & [open, close] : CHUNK_PAIRS) {
-        if (open == c) return true;
+        // Closes the last opened chunk
+        if (depth > 0 && open_chunks[depth - 1] == bracket.chunk) { depth--; continue; }
+
+        // If code reach here, we found a corrupted character
+        return { LineStatus::Corrupted, (uint64_t)bracket.corruption_points };
     }
-    return false;
+
+    if (depth == 0) return { LineStatus::Complete, 0 };
+
+    // Completes the open chunks, from the last opened one
+    uint64_t score = 0;
+    while (depth > 0) { score = score * 5 + open_chunks[--depth] + 1; }
+
+    return { LineStatus::Incomplete, score };
 }
 
-int main(int argc, char* argv[]) {
-    // Common
-    const auto navigation_subsystem = parse_inputs(argc, argv);
+// Lines at least this long are scored by the depth scanner (split in chunks among the threads)
+// > This is only about parallelism: shorter lines nest as deep as they want, since the stack of score_line grows when needed
+#define LONG_LINE_LENGTH 65536
+
+//
+// Scores a single (long) line in parallel, using the depth of every character instead of a stack
+// > Depths come out of a prefix sum of +1 (open) and -1 (close), so every chunk of the line knows its starting depth in advance
+// > A close character always matches the last open character at the same depth, so matches are found in buckets indexed by depth
+// > Every chunk matches what it can on its own, and leaves the closes that go below its starting depth for a final serial merge
+// > Until the first illegal character, this is the very same matching of the stack, so both find the same error and completion
+//
+class DepthScanner
+{
+private:
+    // Minimum amount of characters that justify an extra thread
+    static constexpr std::size_t CHARS_PER_THREAD = 1 << 16;
+
+    // Characters whose depths are computed at once (small enough to stay in cache)
+    static constexpr std::size_t BLOCK_SIZE = 4096;
+
+    static constexpr std::size_t NO_ERROR = SIZE_MAX;
+
+    // Close character whose open character is in a previous chunk
+    struct PendingClose {
+        std::size_t position;
+        int32_t depth;
+        int8_t chunk;
+    };
+
+    // Result of the scan of a single chunk of the line
+    struct ChunkScan {
+        std::size_t error_position = NO_ERROR; // First illegal character found inside the chunk
+        std::vector<PendingClose> pending_closes;
+        int32_t min_depth = 0;
+        int32_t end_depth = 0;
+        std::vector<int8_t> open_chunks;       // Chunk types left open at the depths [min_depth, end_depth)
+    };
+
+    const std::string& _line;
+
+private:
+    // Difference between the opens and the closes of a range of characters
+    // > There are no dependencies between iterations, so the compiler vectorizes it
+    static int32_t _net_depth(const char* chars, std::size_t size) {
+        int32_t net = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            const char c = chars[i];
+            net += (c == '(' || c == '[' || c == '{' || c == '<') - (c == ')' || c == ']' || c == '}' || c == '>');
+        }
+        return net;
+    }
 
-    // Part One algorithms
-    std::unordered_map<char, int> corruption_points = { {')', 3}, {']', 57}, {'}', 1197}, {'>', 25137} };
-    int result_1 = 0;
-
-    float part_1_elapsed_time = time_block( [&](){
-        for (const auto & line : navigation_subsystem) {
-            // Vector that will store the sequence of expected characters to close the chunk
-            // > First element has the lowest priority
-            // > Last element has the highest priority
-            std::vector<char> expected;
-
-            // Goes through every character in the line
-            for (const char & c : line) {
-                // Adds a new close character that is expected to close the new opened chunk
-                if (is_open_char(c)) { expected.push_back(CHUNK_PAIRS[c]); continue; }
-
-                // Chunk closed! Remove expected character from the list
-                if (c == expected.back()) { expected.pop_back(); continue; }
-
-                // If code reach here, we found a corrupted character
-                // > Adds its corruption value into the final score
-                result_1 += corruption_points[c];
-                break;
-            }
+    // Depth after every character of a block, starting at the given depth
+    static void _block_depths(const char* chars, std::size_t size, int32_t depth, int32_t* depths) {
+        std::size_t i = 0;
+
+#if defined(__SSE2__)
+        // 8 characters at a time, as 16 bits lanes
+        // > The deltas of the lanes are added up in log steps, by adding the vector shifted by 1, 2 and 4 lanes
+        auto equals = [](__m128i bytes, char c) { return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)); };
+
+        for (; i + 8 <= size; i += 8) {
+            const __m128i bytes = _mm_loadl_epi64((const __m128i*)(chars + i));
+            const __m128i opens = _mm_or_si128(_mm_or_si128(equals(bytes, '('), equals(bytes, '[')), _mm_or_si128(equals(bytes, '{'), equals(bytes, '<')));
+            const __m128i closes = _mm_or_si128(_mm_or_si128(equals(bytes, ')'), equals(bytes, ']')), _mm_or_si128(equals(bytes, '}'), equals(bytes, '>')));
+
+            // Compare masks are -1, so the delta is closes - opens
+            const __m128i deltas = _mm_sub_epi8(closes, opens);
+            __m128i sums = _mm_srai_epi16(_mm_unpacklo_epi8(_mm_setzero_si128(), deltas), 8);
+            sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 2));
+            sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 4));
+            sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 8));
+
+            const __m128i base = _mm_set1_epi32(depth);
+            _mm_storeu_si128((__m128i*)(depths + i), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), sums), 16)));
+            _mm_storeu_si128((__m128i*)(depths + i + 4), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), sums), 16)));
+
+            depth = depths[i + 7];
         }
-    });
-    
-    // Part One visualization
-    printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
-    printf("   The total syntax error score for all the illegal characters in each corrupted line of the navigation system is %d.\n", result_1);
+#endif
 
+        for (; i < size; i++) {
+            const BracketClass& bracket = BRACKET_CLASSES[(uint8_t)chars[i]];
+            depth += (bracket.chunk < 0) ? 0 : bracket.is_open ? 1 : -1;
+            depths[i] = depth;
+        }
+    }
 
+    ChunkScan _scan_chunk(std::size_t begin, std::size_t end, int32_t start_depth) const {
+        ChunkScan scan;
+        scan.min_depth = start_depth;
 
-    // Part Two algorithms
-    std::unordered_map<char, int> incomplete_score = { {')', 1}, {']', 2}, {'}', 3}, {'>', 4} };
-    int result_2 = 0;
+        // Last open character at every depth this chunk is able to reach
+        const int32_t lowest_depth = start_depth - (int32_t)(end - begin);
+        std::vector<int8_t> last_open(2 * (end - begin) + 1, -1);
+
+        std::array<int32_t, BLOCK_SIZE> depths;
+        int32_t depth = start_depth;
+
+        for (std::size_t block = begin; block < end; block += BLOCK_SIZE) {
+            const std::size_t block_size = std::min(BLOCK_SIZE, end - block);
+            _block_depths(_line.data() + block, block_size, depth, depths.data());
 
-    float part_2_elapsed_time = time_block( [&](){
-        std::vector<uint64_t> scores;
+            for (std::size_t i = 0; i < block_size; i++) {
+                const BracketClass& bracket = BRACKET_CLASSES[(uint8_t)_line[block + i]];
+                if (bracket.chunk < 0) throw std::invalid_argument("Invalid character in line at position " + std::to_string(block + i) + ".");
 
-        for (const auto & line : navigation_subsystem) {
-            // Control variable to know if the line is corrupted
-            bool is_corrupted = false;
+                // Opens are placed at the depth before them
+                if (bracket.is_open) { last_open[depths[i] - 1 - lowest_depth] = bracket.chunk; continue; }
 
-            // Vector that will store the sequence of expected characters to close the chunk
-            // > First element has the lowest priority
-            // > Last element has the highest priority
-            std::vector<char> expected;
+                // Closes below every depth seen so far have their open character in a previous chunk
+                if (depths[i] < scan.min_depth) {
+                    scan.pending_closes.push_back({ block + i, depths[i], bracket.chunk });
+                    scan.min_depth = depths[i];
+                    continue;
+                }
 
-            // Goes through every character in the line
-            for (const char & c : line) {
-                // Adds a new close character that is expected to close the new opened chunk
-                if (is_open_char(c)) { expected.push_back(CHUNK_PAIRS[c]); continue; }
+                // Otherwise, they must match the last open character at the depth after them
+                if (last_open[depths[i] - lowest_depth] != bracket.chunk) {
+                    scan.error_position = block + i;
+                    return scan;
+                }
+            }
+
+            depth = depths[block_size - 1];
+        }
+
+        // All the depths between the lowest one and the end are still open
+        scan.end_depth = depth;
+        for (int32_t d = scan.min_depth; d < scan.end_depth; d++) { scan.open_chunks.push_back(last_open[d - lowest_depth]); }
+
+        return scan;
+    }
 
-                // Chunk closed! Remove expected character from the list
-                if (c == expected.back()) { expected.pop_back(); continue; }
+public:
+    DepthScanner() = delete;
+    DepthScanner(const std::string& line) : _line(line) {
+        if (line.size() >= INT32_MAX) throw std::invalid_argument("Lines longer than 2^31 characters are not supported.");
+    }
 
-                // Updates the corruption flag
-                is_corrupted = true;
-                break;
+    LineScore score() const {
+        const std::size_t n_threads = std::clamp<std::size_t>(_line.size() / CHARS_PER_THREAD, 1, std::max(1u, std::thread::hardware_concurrency()));
+        const std::size_t chunk = (_line.size() + n_threads - 1) / n_threads;
+
+        // Starting depth of every chunk (prefix sum of the net depths of the previous ones)
+        std::vector<int32_t> start_depths(n_threads + 1, 0);
+        {
+            std::vector<std::thread> workers;
+            for (std::size_t w = 0; w < n_threads; w++) {
+                workers.emplace_back([this, &start_depths, w, chunk](){
+                    const std::size_t begin = std::min(_line.size(), w * chunk);
+                    const std::size_t end = std::min(_line.size(), begin + chunk);
+                    start_depths[w + 1] = _net_depth(_line.data() + begin, end - begin);
+                });
             }
+            for (auto & worker : workers) { worker.join(); }
+        }
+        for (std::size_t w = 0; w < n_threads; w++) { start_depths[w + 1] += start_depths[w]; }
+
+        // Scans every chunk on its own
+        std::vector<ChunkScan> scans(n_threads);
+        std::vector<std::exception_ptr> errors(n_threads);
+        {
+            std::vector<std::thread> workers;
+            for (std::size_t w = 0; w < n_threads; w++) {
+                workers.emplace_back([this, &start_depths, &scans, &errors, w, chunk](){
+                    const std::size_t begin = std::min(_line.size(), w * chunk);
+                    const std::size_t end = std::min(_line.size(), begin + chunk);
+                    try { scans[w] = _scan_chunk(begin, end, start_depths[w]); }
+                    catch (...) { errors[w] = std::current_exception(); }
+                });
+            }
+            for (auto & worker : workers) { worker.join(); }
+        }
 
-            // Do not proceed if the current line is corrupted
-            if (is_corrupted) { continue; }
+        // Invalid characters are reported back in the calling thread
+        for (const auto & error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+
+        // Merges the chunks in order, keeping the open chunk type at every depth
+        // > The first chunk with an error (of its own or from its pending closes) has the first illegal character of the line
+        std::vector<int8_t> open_at_depth;
+        for (const auto & scan : scans) {
+            std::size_t error_position = scan.error_position;
 
-            // Do not proceed if the current line is complete
-            if (!expected.size()) { continue; }
+            for (const auto & pending : scan.pending_closes) {
+                if (pending.position > error_position) break;
+                if (pending.depth < 0 || open_at_depth[pending.depth] != pending.chunk) { error_position = pending.position; break; }
+            }
 
-            // Lets calculate the line incompletion score
-            uint64_t score = 0;
-            while (!expected.empty()) {
-                score = score * 5 + incomplete_score[expected.back()];
-                expected.pop_back();
+            if (error_position != NO_ERROR) {
+                return { LineStatus::Corrupted, (uint64_t)BRACKET_CLASSES[(uint8_t)_line[error_position]].corruption_points };
             }
-            
-            // Adds the score into the list of scores
-            scores.push_back(score);
+
+            if (open_at_depth.size() < scan.end_depth) { open_at_depth.resize(scan.end_depth); }
+            std::copy(scan.open_chunks.begin(), scan.open_chunks.end(), open_at_depth.begin() + scan.min_depth);
         }
 
-        // Ascending sort of the scores
-        std::sort(scores.begin(), scores.end(), [](const uint64_t &a, const uint64_t& b){ return a <= b; });
+        const int32_t end_depth = start_depths.back();
+        if (end_depth == 0) return { LineStatus::Complete, 0 };
+
+        // Completes the open chunks, from the deepest one
+        uint64_t score = 0;
+        for (int32_t depth = end_depth - 1; depth >= 0; depth--) { score = score * 5 + open_at_depth[depth] + 1; }
+
+        return { LineStatus::Incomplete, score };
+    }
+};
+
+//
+// Scores of the whole navigation subsystem
+//
+struct NavigationScores {
+    uint64_t syntax_error_score = 0;        // Sum of the corruption scores of all corrupted lines
+    std::vector<uint64_t> completion_scores; // Completion score of every incomplete line
+};
+
+// Minimum amount of lines that justify an extra thread
+#define LINES_PER_THREAD 16384
+
+//
+// Scores all the lines, splitting them in contiguous chunks among the threads
+// > Each thread keeps its own error score and completion scores buffer, which are only joined at the end
+// > Lines of at least long_line_length characters are left out, and scored afterwards by the depth scanner (which has its own threads)
+//
+NavigationScores score_lines(const std::vector<std::string>& lines, std::size_t long_line_length) {
+    const std::size_t n_threads = std::clamp<std::size_t>(lines.size() / LINES_PER_THREAD, 1, std::max(1u, std::thread::hardware_concurrency()));
+    const std::size_t chunk = (lines.size() + n_threads - 1) / n_threads;
+
+    std::vector<NavigationScores> thread_scores(n_threads);
+    std::vector<std::exception_ptr> errors(n_threads);
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < n_threads; w++) {
+        workers.emplace_back([&lines, &thread_scores, &errors, long_line_length, w, chunk](){
+            const std::size_t begin = std::min(lines.size(), w * chunk);
+            const std::size_t end = std::min(lines.size(), begin + chunk);
+
+            NavigationScores& scores = thread_scores[w];
+            try {
+                for (std::size_t i = begin; i < end; i++) {
+                    if (lines[i].size() >= long_line_length) continue;
+
+                    const auto [status, score] = score_line(lines[i]);
+                    if (status == LineStatus::Corrupted) { scores.syntax_error_score += score; }
+                    if (status == LineStatus::Incomplete) { scores.completion_scores.push_back(score); }
+                }
+            }
+            catch (...) { errors[w] = std::current_exception(); }
+        });
+    }
+    for (auto & worker : workers) { worker.join(); }
+
+    // Invalid lines are reported back in the calling thread
+    for (const auto & error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    NavigationScores total;
+    for (const auto & scores : thread_scores) {
+        total.syntax_error_score += scores.syntax_error_score;
+        total.completion_scores.insert(total.completion_scores.end(), scores.completion_scores.begin(), scores.completion_scores.end());
+    }
+
+    for (const auto & line : lines) {
+        if (line.size() < long_line_length) continue;
+
+        const auto [status, score] = DepthScanner(line).score();
+        if (status == LineStatus::Corrupted) { total.syntax_error_score += score; }
+        if (status == LineStatus::Incomplete) { total.completion_scores.push_back(score); }
+    }
+
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    // Common
+    const auto navigation_subsystem = parse_inputs(argc, argv);
+
+    // Options
+    // > "--depth-scan" scores every line with the depth scanner, not only the long ones
+    bool DEPTH_SCAN = false;
+    for (int i = 2; i < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--depth-scan") { DEPTH_SCAN = true; }
+        else { throw std::invalid_argument("Unknown option " + option + "."); }
+    }
+
+    // Both parts come out of the same scoring pass
+    NavigationScores scores;
+
+    float scoring_elapsed_time = time_block( [&](){
+        scores = score_lines(navigation_subsystem, DEPTH_SCAN ? 0 : LONG_LINE_LENGTH);
+    });
+
+    // Part One algorithms
+    uint64_t result_1 = 0;
+
+    float part_1_elapsed_time = scoring_elapsed_time + time_block( [&](){
+        result_1 = scores.syntax_error_score;
+    });
+    
+    // Part One visualization
+    printf("\n> Part One < (%f seconds)\n", part_1_elapsed_time);
+    printf("   The total syntax error score for all the illegal characters in each corrupted line of the navigation system is %llu.\n", (unsigned long long)result_1);
+
+
+
+    // Part Two algorithms
+    uint64_t result_2 = 0;
+
+    float part_2_elapsed_time = scoring_elapsed_time + time_block( [&](){
+        std::vector<uint64_t>& completion_scores = scores.completion_scores;
+
+        // Guarantees that there is at least one incomplete line
+        if (completion_scores.empty()) { throw std::runtime_error("Something went wrong... There are no incomplete lines."); }
+
+        // Only the middle score has to be in place (this assumes that the scores size is always odd)
+        auto middle = completion_scores.begin() + (completion_scores.size() - 1) / 2;
+        std::nth_element(completion_scores.begin(), middle, completion_scores.end());
 
-        // Gets the middle score (this assumes that the scores size is always odd)
-        result_2 = scores[ (scores.size()-1) / 2 ];
+        result_2 = *middle;
     });
 
     // Part Two visualization
     printf("\n> Part Two < (%f seconds)\n", part_2_elapsed_time);
-    printf("   The middle score from the list of all incomplete lines is %d.\n", result_2);  
+    printf("   The middle score from the list of all incomplete lines is %llu.\n", (unsigned long long)result_2);  
 
     return 0;
 }